@@ -260,6 +260,9 @@ public:
 	void cacheTranspose() ;
 	//! Returns whether the transpose has been cached
 	bool transposeCached() const { return m_transposeIndex.valid ; }
+	//! Updates the cached transpose of the block at ( \p row, \p col ) after it has been modified in place
+	/*! Does nothing if the transpose has not been cached. Distinct blocks may be updated concurrently. */
+	void updateTransposedBlock( Index row, Index col ) ;
 
 	const MajorIndexType& majorIndex() const
 	{
@@ -241,6 +241,27 @@ void SparseBlockMatrixBase<Derived>::cacheTranspose()
 
 }
 
+template < typename Derived >
+void SparseBlockMatrixBase<Derived>::updateTransposedBlock( Index row, Index col )
+{
+	if ( !m_transposeIndex.valid ) return ;
+
+	const BlockPtr ptr = blockPtr( row, col ) ;
+	if( ptr == InvalidBlockPtr ) return ;
+
+	if( Traits::is_col_major ) std::swap( row, col ) ;
+
+	const typename TransposeIndexType::InnerIterator innerIt( m_transposeIndex, col ) ;
+
+	const typename TransposeIndexType::InnerIterator
+			found( std::lower_bound( innerIt, innerIt.end(), row ) ) ;
+
+	if( found && found.inner() == row )
+	{
+		m_transposeBlocks[ found.ptr() ] = transpose_block( m_blocks[ ptr ] ) ;
+	}
+}
+
 template < typename Derived >
 typename SparseBlockMatrixBase< Derived >::BlockPtr SparseBlockMatrixBase< Derived >::diagonalBlockPtr( const Index row ) const
 {
@@ -13,6 +13,8 @@
 
 #include "../Block.fwd.hpp"
 
+#include <vector>
+
 namespace bogus {
 
 //! Coloring
@@ -57,6 +59,15 @@ private:
 
 	template < typename Derived >
 	void compute( const BlockMatrixBase< Derived >& matrix ) ;
+
+	//! Rows interacting with each row, as offsets into \p adjacency
+	template < typename Derived >
+	static void computeAdjacency( const SparseBlockMatrixBase< Derived >& matrix,
+								  std::vector< std::ptrdiff_t >& offsets, std::vector< std::ptrdiff_t >& adjacency ) ;
+
+	//! Moves rows from the largest colors to the smallest compatible ones
+	static void balance( const std::vector< std::ptrdiff_t >& offsets, const std::vector< std::ptrdiff_t >& adjacency,
+						 const std::size_t nColors, std::vector< std::ptrdiff_t >& rowColors ) ;
 } ;
 
 }
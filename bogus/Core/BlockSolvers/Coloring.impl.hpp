@@ -15,60 +15,206 @@
 
 #include "../Block/SparseBlockMatrixBase.hpp"
 
+#include <algorithm>
+
 namespace bogus {
 
+namespace coloring_impl {
+
+//! Strict order between rows ; rows with more neighbours come first, ties are broken pseudo-randomly
+inline bool hasPriority( const std::ptrdiff_t i, const std::ptrdiff_t j, const std::vector< std::ptrdiff_t >& offsets )
+{
+	const std::ptrdiff_t di = offsets[i+1] - offsets[i] ;
+	const std::ptrdiff_t dj = offsets[j+1] - offsets[j] ;
+	if( di != dj ) return di > dj ;
+
+	const unsigned hi = ( (unsigned) i ) * 2654435761u ;
+	const unsigned hj = ( (unsigned) j ) * 2654435761u ;
+	if( hi != hj ) return hi > hj ;
+
+	return i > j ;
+}
+
+} //namespace coloring_impl
+
+template < typename Derived >
+void Coloring::computeAdjacency( const SparseBlockMatrixBase< Derived >& matrix,
+								 std::vector< std::ptrdiff_t >& offsets, std::vector< std::ptrdiff_t >& adjacency )
+{
+	// Only the lower triangle is read, and mirrored, as symmetric matrices only store that part.
+	// Non-symmetric matrices may then yield duplicate neighbours, which is harmless
+
+	const std::ptrdiff_t n = static_cast< std::ptrdiff_t >( matrix.rowsOfBlocks() ) ;
+
+	offsets.assign( n+1, 0 ) ;
+	for( std::ptrdiff_t i = 0 ; i < n ; ++i )
+	{
+		for( typename Derived::MajorIndexType::InnerIterator it( matrix.majorIndex(), i ) ;
+			 it && it.inner() < i ; ++ it )
+		{
+			++offsets[ i+1 ] ;
+			++offsets[ it.inner()+1 ] ;
+		}
+	}
+	for( std::ptrdiff_t i = 0 ; i < n ; ++i )
+	{
+		offsets[ i+1 ] += offsets[ i ] ;
+	}
+
+	adjacency.resize( offsets[n] ) ;
+	std::vector< std::ptrdiff_t > cursor( offsets.begin(), offsets.end() - 1 ) ;
+	for( std::ptrdiff_t i = 0 ; i < n ; ++i )
+	{
+		for( typename Derived::MajorIndexType::InnerIterator it( matrix.majorIndex(), i ) ;
+			 it && it.inner() < i ; ++ it )
+		{
+			adjacency[ cursor[ i ]++ ] = it.inner() ;
+			adjacency[ cursor[ it.inner() ]++ ] = i ;
+		}
+	}
+}
+
+inline void Coloring::balance( const std::vector< std::ptrdiff_t >& offsets, const std::vector< std::ptrdiff_t >& adjacency,
+							   const std::size_t nColors, std::vector< std::ptrdiff_t >& rowColors )
+{
+	// First-fit leaves the last colors nearly empty, while the parallel Gauss-Seidel
+	// synchronizes after each color. Rows of colors larger than the mean size
+	// are moved to the smallest color that none of their neighbours use
+
+	const std::ptrdiff_t n = rowColors.size() ;
+	if( nColors < 2 ) return ;
+
+	std::vector< std::ptrdiff_t > sizes( nColors, 0 ) ;
+	for( std::ptrdiff_t i = 0 ; i < n ; ++i )
+	{
+		++sizes[ rowColors[i] ] ;
+	}
+	const std::ptrdiff_t target = ( n + nColors - 1 ) / nColors ;
+
+	std::vector< unsigned char > forbidden( nColors, 0 ) ;
+	for( std::ptrdiff_t i = 0 ; i < n ; ++i )
+	{
+		const std::ptrdiff_t c = rowColors[i] ;
+		if( sizes[ c ] <= target ) continue ;
+
+		for( std::ptrdiff_t k = offsets[i] ; k < offsets[i+1] ; ++k )
+		{
+			forbidden[ rowColors[ adjacency[k] ] ] = 1 ;
+		}
+
+		std::ptrdiff_t best = -1 ;
+		for( std::ptrdiff_t d = 0 ; d < (std::ptrdiff_t) nColors ; ++d )
+		{
+			if( !forbidden[d] && sizes[d] < target && ( best == -1 || sizes[d] < sizes[best] ) )
+				best = d ;
+		}
+
+		for( std::ptrdiff_t k = offsets[i] ; k < offsets[i+1] ; ++k )
+		{
+			forbidden[ rowColors[ adjacency[k] ] ] = 0 ;
+		}
+
+		if( best != -1 )
+		{
+			--sizes[ c ] ;
+			++sizes[ best ] ;
+			rowColors[i] = best ;
+		}
+	}
+}
+
 template < typename Derived >
 void Coloring::compute( const SparseBlockMatrixBase< Derived >& matrix )
 {
 
-	// Affects each contact to the first color with which it does not have any interaction
-	// This is not optimimal, but optimality would be costly
+	// Jones-Plassmann coloring: at each round, the uncolored rows that have priority
+	// over all their uncolored neighbours take the first color unused by their neighbours.
+	// Those rows are independent, so each round can be processed in parallel,
+	// and the result does not depend on the number of threads
 
 	const std::ptrdiff_t n = static_cast< std::ptrdiff_t >( matrix.rowsOfBlocks() ) ;
 
-	std::vector< std::vector< std::ptrdiff_t > > tmp_colors ;
+	std::vector< std::ptrdiff_t > offsets, adjacency ;
+	computeAdjacency( matrix, offsets, adjacency ) ;
+
+	std::vector< std::ptrdiff_t > rowColors( n, -1 ) ;
+	std::vector< std::ptrdiff_t > pending( n ) ;
 	for( std::ptrdiff_t i = 0 ; i < n ; ++i )
 	{
-		bool ok = false ;
+		pending[i] = i ;
+	}
 
-		const unsigned nColors = tmp_colors.size() ;
+	std::vector< unsigned char > selected ;
+	while( !pending.empty() )
+	{
+		const std::ptrdiff_t nPending = pending.size() ;
+		selected.assign( nPending, 0 ) ;
 
-		for( unsigned c = 0 ; c < nColors ; ++c )
+#ifndef BOGUS_DONT_PARALLELIZE
+#pragma omp parallel for
+#endif
+		for( std::ptrdiff_t k = 0 ; k < nPending ; ++k )
 		{
-			std::vector< std::ptrdiff_t > &color = tmp_colors[ c ] ;
-			ok = true ;
-			for( typename Derived::MajorIndexType::InnerIterator it( matrix.majorIndex(), i ) ;
-				 it && it.inner() < i ; ++ it )
+			const std::ptrdiff_t i = pending[k] ;
+			bool isMax = true ;
+			for( std::ptrdiff_t a = offsets[i] ; isMax && a < offsets[i+1] ; ++a )
 			{
-				if( color.end() !=
-						std::lower_bound( color.begin(), color.end(), it.inner() ) )
-				{
-					ok = false ;
-					break ;
-				}
+				const std::ptrdiff_t j = adjacency[a] ;
+				isMax = rowColors[j] != -1 || !coloring_impl::hasPriority( j, i, offsets ) ;
 			}
-			if( ok )
+			selected[k] = isMax ;
+		}
+
+#ifndef BOGUS_DONT_PARALLELIZE
+#pragma omp parallel for
+#endif
+		for( std::ptrdiff_t k = 0 ; k < nPending ; ++k )
+		{
+			if( !selected[k] ) continue ;
+
+			// A row with d neighbours always finds a free color in [0,d]
+			const std::ptrdiff_t i = pending[k] ;
+			std::vector< unsigned char > used( offsets[i+1] - offsets[i] + 1, 0 ) ;
+			for( std::ptrdiff_t a = offsets[i] ; a < offsets[i+1] ; ++a )
 			{
-				color.push_back( i ) ;
-				break ;
+				const std::ptrdiff_t c = rowColors[ adjacency[a] ] ;
+				if( c != -1 && c < (std::ptrdiff_t) used.size() ) used[c] = 1 ;
 			}
+			rowColors[i] = std::find( used.begin(), used.end(), 0 ) - used.begin() ;
 		}
-		if( !ok )
+
+		std::ptrdiff_t nRemaining = 0 ;
+		for( std::ptrdiff_t k = 0 ; k < nPending ; ++k )
 		{
-			tmp_colors.resize( nColors+1 ) ;
-			tmp_colors.back().push_back( i ) ;
+			if( !selected[k] ) pending[ nRemaining++ ] = pending[k] ;
 		}
+		pending.resize( nRemaining ) ;
+	}
+
+	std::size_t nColors = 0 ;
+	for( std::ptrdiff_t i = 0 ; i < n ; ++i )
+	{
+		nColors = std::max( nColors, (std::size_t) rowColors[i] + 1 ) ;
 	}
 
-	permutation.clear() ;
+	balance( offsets, adjacency, nColors, rowColors ) ;
 
-	colors.resize( tmp_colors.size()+1 ) ;
-	colors[ 0 ] = 0 ;
+	// Rows sorted by color, then by index
+	colors.assign( nColors+1, 0 ) ;
+	for( std::ptrdiff_t i = 0 ; i < n ; ++i )
+	{
+		++colors[ rowColors[i]+1 ] ;
+	}
+	for( std::size_t c = 0 ; c < nColors ; ++c )
+	{
+		colors[ c+1 ] += colors[ c ] ;
+	}
 
-	for( unsigned c = 0 ; c < tmp_colors.size() ; ++c )
+	permutation.resize( n ) ;
+	std::vector< std::ptrdiff_t > cursor( colors.begin(), colors.end() - 1 ) ;
+	for( std::ptrdiff_t i = 0 ; i < n ; ++i )
 	{
-		colors[ c+1 ] = colors[c] + tmp_colors[c].size() ;
-		permutation.insert( permutation.end(), tmp_colors[c].begin(), tmp_colors[c].end() ) ;
+		permutation[ cursor[ rowColors[i] ]++ ] = i ;
 	}
 
 }
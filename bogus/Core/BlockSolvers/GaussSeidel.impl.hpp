@@ -87,9 +87,8 @@ typename GaussSeidel< BlockMatrixType >::Scalar GaussSeidel< BlockMatrixType >::
 	std::vector< unsigned char > skip( n, 0 ) ;
 
 #ifndef BOGUS_DONT_PARALLELIZE
-	const int curMaxThreads = omp_get_max_threads() ;
-	const int newMaxThreads = m_maxThreads == 0 ? curMaxThreads : m_maxThreads ;
-	omp_set_num_threads( newMaxThreads ) ;
+	// The thread count is only given to our own parallel region, the caller's one is left untouched
+	const int newMaxThreads = m_maxThreads == 0 ? omp_get_max_threads() : m_maxThreads ;
 #endif
 
 	Scalar ndxRef = 0 ; //Reference step size
@@ -99,9 +98,15 @@ typename GaussSeidel< BlockMatrixType >::Scalar GaussSeidel< BlockMatrixType >::
 	unsigned GSIter ;
 	for( GSIter = 1 ; GSIter <= m_maxIters ; ++GSIter )
 	{
+		// A good initial guess ( e.g. warm-start ) may already be a solution
+		if( 1 == GSIter && err_best < m_tol )
+		{
+			GSIter = 0 ;
+			break ;
+		}
 
 #ifndef BOGUS_DONT_PARALLELIZE
-#pragma omp parallel if (m_maxThreads != 1 && n > newMaxThreads*newMaxThreads )
+#pragma omp parallel num_threads( newMaxThreads ) if (m_maxThreads != 1 && n > newMaxThreads*newMaxThreads )
 		{
 #endif
 
@@ -181,9 +186,7 @@ typename GaussSeidel< BlockMatrixType >::Scalar GaussSeidel< BlockMatrixType >::
 
 	}
 
-#ifndef BOGUS_DONT_PARALLELIZE
-	omp_set_num_threads( curMaxThreads ) ;
-#endif
+	this->m_lastIterations = std::min( GSIter, m_maxIters ) ;
 
 	if( GSIter > m_maxIters ){
 		x = x_best;
@@ -79,6 +79,9 @@ public:
 	//! Sets the number of iterations for temporarily freezing local problems
 	void setSkipIters( unsigned skipIters ) { m_skipIters = skipIters ; }
 
+	//! Number of sweeps performed by the last call to solve()
+	unsigned lastIterations() const { return m_lastIterations ; }
+
 
 protected:
 
@@ -86,7 +89,8 @@ protected:
 		m_maxThreads (  0 ),
 		m_evalEvery ( 50  ), // 25
 		m_skipIters ( 10 ),
-		m_autoRegularization ( 0. )
+		m_autoRegularization ( 0. ),
+		m_lastIterations ( 0 )
 	{
 		m_tol = 1.e-8 ; // 1e-12
 		m_maxIters = 500;
@@ -118,6 +122,9 @@ protected:
 	//! \sa setAutoRegularization(). Defaults to 0.
 	Scalar m_autoRegularization ;
 
+	//! \sa lastIterations()
+	mutable unsigned m_lastIterations ;
+
 } ;
 
 } //namespace bogus
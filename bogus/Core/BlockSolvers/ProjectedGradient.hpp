@@ -19,6 +19,14 @@
 namespace bogus
 {
 
+namespace projected_gradient {
+//! Variants of the projected gradient algorithm
+enum Variant {
+	Standard,	//!< Projected gradient with Armijo line-search
+	APGD		//!< Nesterov-accelerated projected gradient with adaptive restart
+} ;
+}
+
 //! Projected Gradient iterative solver.
 template < typename BlockMatrixType >
 class ProjectedGradient : public ConstrainedSolverBase< ProjectedGradient, BlockMatrixType >
@@ -35,10 +43,17 @@ public:
 	explicit ProjectedGradient( const BlockMatrixBase< BlockMatrixType > & matrix ) : Base()
 	{ init() ; Base::setMatrix( matrix ) ; }
 
-	//! Finds an approximate solution for a constrained linear problem
+	//! Finds an approximate solution for a constrained linear problem, using the default variant
 	template < typename NSLaw, typename RhsT, typename ResT >
 	Scalar solve( const NSLaw &law, const RhsT &b, ResT &x ) const ;
 
+	//! Sets the variant that will be used when calling solve()
+	void setDefaultVariant( projected_gradient::Variant variant )
+	{ m_defaultVariant = variant ; }
+
+	//! Number of iterations performed during the last call to solve()
+	unsigned lastIterations() const { return m_lastIterations ; }
+
 
 	void setMatrix( const BlockMatrixBase< BlockMatrixType > & matrix )
 	{
@@ -53,6 +68,12 @@ protected:
 	template < typename NSLaw, typename VectorT >
 	void projectOnConstraints( const NSLaw &projector, VectorT &x ) const ;
 
+	template < typename NSLaw, typename RhsT, typename ResT >
+	Scalar solveStandard( const NSLaw &law, const RhsT &b, ResT &x ) const ;
+
+	template < typename NSLaw, typename RhsT, typename ResT >
+	Scalar solveAPGD( const NSLaw &law, const RhsT &b, ResT &x ) const ;
+
 	//! Sets up the default values for all parameters
 	void init()
 	{
@@ -62,6 +83,8 @@ protected:
 		m_lsOptimisticFactor = 2 ;
 		m_lsPessimisticFactor = .5 ;
 		m_lsArmijoCriterion = 1.e-4;
+		m_defaultVariant = projected_gradient::Standard ;
+		m_lastIterations = 0 ;
 	}
 
 	using Base::m_matrix ;
@@ -73,6 +96,11 @@ protected:
 	Scalar m_lsPessimisticFactor ;
 	Scalar m_lsArmijoCriterion ;
 
+	//! See setDefaultVariant()
+	projected_gradient::Variant m_defaultVariant ;
+	//! \sa lastIterations()
+	mutable unsigned m_lastIterations ;
+
 } ;
 
 } //namespace bogus
@@ -24,6 +24,21 @@ typename ProjectedGradient< BlockMatrixType >::Scalar
 ProjectedGradient< BlockMatrixType >::solve(
 		const NSLaw &law, const RhsT &b, ResT &x ) const
 {
+	switch( m_defaultVariant )
+	{
+	case projected_gradient::APGD:
+		return solveAPGD( law, b, x ) ;
+	default:
+		return solveStandard( law, b, x ) ;
+	}
+}
+
+template < typename BlockMatrixType >
+template < typename NSLaw, typename RhsT, typename ResT >
+typename ProjectedGradient< BlockMatrixType >::Scalar
+ProjectedGradient< BlockMatrixType >::solveStandard(
+		const NSLaw &law, const RhsT &b, ResT &x ) const
+{
 
 	typename GlobalProblemTraits::DynVector
 			Mx ( b.rows() ),
@@ -39,7 +54,8 @@ ProjectedGradient< BlockMatrixType >::solve(
 
 	Scalar res = -1, alpha = 1 ;
 
-	for( unsigned pgIter = 0 ; pgIter < m_maxIters ; ++pgIter )
+	unsigned pgIter ;
+	for( pgIter = 0 ; pgIter < m_maxIters ; ++pgIter )
 	{
 		// y = grad J = Mx+b
 		y = Mx + b ;
@@ -72,10 +88,110 @@ ProjectedGradient< BlockMatrixType >::solve(
 		J = Js ;
 	}
 
+	m_lastIterations = pgIter ;
 
 	return res ;
 }
 
+template < typename BlockMatrixType >
+template < typename NSLaw, typename RhsT, typename ResT >
+typename ProjectedGradient< BlockMatrixType >::Scalar
+ProjectedGradient< BlockMatrixType >::solveAPGD(
+		const NSLaw &law, const RhsT &b, ResT &x ) const
+{
+	// Nesterov's accelerated projected gradient, with a backtracking estimate of
+	// the Lipschitz constant L of the gradient, and the gradient-based adaptive restart
+	// of O'Donoghue and Candes. M y is extrapolated from the previous products, so an iteration
+	// requires one matrix-vector product per backtracking step, and per-row projections
+
+	typename GlobalProblemTraits::DynVector
+			Mx ( b.rows() ),
+			Mxs( b.rows() ),
+			My ( b.rows() ),
+			g  ( b.rows() ), // = My + b
+			y  ( x.rows() ), // extrapolated point
+			xs ( x.rows() ), // tentative new value for x
+			x_best( x.rows() )
+			;
+
+	projectOnConstraints( law, x ) ;
+	Mx = (*m_matrix)*x ;
+
+	// Initial estimate of L from a finite difference
+	xs = x + GlobalProblemTraits::DynVector::Ones( x.rows() ) ;
+	Mxs = (*m_matrix)*xs ;
+	Scalar L = ( Mxs - Mx ).norm() / std::sqrt( (Scalar) x.rows() ) ;
+	if( !( L > 0 ) ) L = 1 ;
+
+	y = x ;
+	My = Mx ;
+	x_best = x ;
+
+	Scalar theta = 1, res = -1, res_best = -1 ;
+
+	unsigned pgIter ;
+	for( pgIter = 0 ; pgIter < m_maxIters ; ++pgIter )
+	{
+		g = My + b ;
+		const Scalar Jy = y.dot( .5 * My + b ) ;
+
+		// Increases L until the quadratic upper bound holds at xs
+		for( unsigned lsIter = 0 ; ; ++lsIter )
+		{
+			xs = y - g / L ;
+			projectOnConstraints( law, xs ) ;
+			Mxs = (*m_matrix)*xs ;
+
+			const Scalar Js = xs.dot( .5 * Mxs + b ) ;
+			if( lsIter+1 >= m_lsIters ||
+					Js <= Jy + g.dot( xs - y ) + .5 * L * ( xs - y ).squaredNorm() )
+				break ;
+
+			L /= m_lsPessimisticFactor ;
+		}
+
+		// Restart when the momentum goes against the gradient
+		const bool restart = g.dot( xs - x ) > 0 ;
+
+		g = Mxs + b ;
+		res = Base::eval( law, g, xs ) ;
+		this->m_callback.trigger( pgIter, res );
+
+		if( res_best < 0 || res < res_best )
+		{
+			res_best = res ;
+			x_best = xs ;
+		}
+		if( res < m_tol ) break ;
+
+		if( restart )
+		{
+			theta = 1 ;
+			y = xs ;
+			My = Mxs ;
+		} else {
+			const Scalar theta2 = theta * theta ;
+			const Scalar thetaNext = .5 * ( theta * std::sqrt( theta2 + 4 ) - theta2 ) ;
+			const Scalar beta = theta * ( 1 - theta ) / ( theta2 + thetaNext ) ;
+			theta = thetaNext ;
+
+			y  = xs  + beta * ( xs  - x  ) ;
+			My = Mxs + beta * ( Mxs - Mx ) ;
+		}
+
+		x = xs ;
+		Mx = Mxs ;
+
+		// Optimistic decrease of L, so that the step size may grow again
+		L *= std::sqrt( m_lsPessimisticFactor ) ;
+	}
+
+	m_lastIterations = pgIter ;
+
+	x = x_best ;
+	return res_best ;
+}
+
 template < typename BlockMatrixType >
 template < typename NSLaw, typename VectorT >
 void ProjectedGradient< BlockMatrixType >::projectOnConstraints(
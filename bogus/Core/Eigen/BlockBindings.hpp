@@ -97,6 +97,34 @@ inline void resize ( Eigen::SparseMatrix< Scalar, Options, Index >& block, Index
 	block.resize( rows, cols ) ;
 }
 
+// Products of sparse and dense blocks are dense
+
+template<
+	typename _Scalar, int _Options, typename _Index,
+	typename _Scalar2, int _Rows2, int _Cols2, int _Options2, int _MaxRows2, int _MaxCols2,
+	bool TransposeLhs, bool TransposeRhs >
+struct BlockBlockProductTraits <
+		 Eigen::SparseMatrix< _Scalar, _Options, _Index >,
+		 Eigen::Matrix<_Scalar2, _Rows2, _Cols2, _Options2, _MaxRows2, _MaxCols2>,
+		TransposeLhs, TransposeRhs >
+{
+	typedef Eigen::Matrix< _Scalar, Eigen::Dynamic, SwapIf< TransposeRhs, _Rows2, _Cols2 >::Second >
+	ReturnType ;
+} ;
+
+template<
+	typename _Scalar, int _Rows, int _Cols, int _Options, int _MaxRows, int _MaxCols,
+	typename _Scalar2, int _Options2, typename _Index2,
+	bool TransposeLhs, bool TransposeRhs >
+struct BlockBlockProductTraits <
+		 Eigen::Matrix<_Scalar, _Rows, _Cols, _Options, _MaxRows, _MaxCols>,
+		 Eigen::SparseMatrix< _Scalar2, _Options2, _Index2 >,
+		TransposeLhs, TransposeRhs >
+{
+	typedef Eigen::Matrix< _Scalar, SwapIf< TransposeLhs, _Rows, _Cols >::First, Eigen::Dynamic >
+	ReturnType ;
+} ;
+
 #endif
 
 // Block traits for Eigen::Matrix
@@ -0,0 +1,118 @@
+/*
+ * This file is part of So-bogus, a C++ sparse block matrix library and
+ * Second Order Cone solver.
+ *
+ * Copyright 2013 Gilles Daviet <gdaviet@gmail.com>
+ *
+ * So-bogus is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+
+ * So-bogus is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with So-bogus.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BOGUS_BAND_SOLVER_HPP
+#define BOGUS_BAND_SOLVER_HPP
+
+#include "../Core/Eigen/EigenLinearSolvers.hpp"
+
+#include "../../hairSim/Math/SymmetricBandMatrixSolver.h"
+
+namespace bogus
+{
+
+struct BandSolver ;
+
+template < >
+struct LinearSolverTraits< BandSolver >
+{
+	typedef Eigen::MatrixXd MatrixType ;
+	typedef SymmetricBandMatrixSolver< double, 10 > FactType ;
+
+	// The band solver works in place on plain dynamic vectors or matrices
+	template < typename RhsT > struct Result {
+		typedef typename Eigen::internal::conditional< RhsT::ColsAtCompileTime == 1,
+				Eigen::VectorXd, Eigen::MatrixXd >::type Type ;
+	} ;
+	template < typename RhsT >
+	struct Result< Eigen::MatrixBase< RhsT > > {
+		typedef typename Result< RhsT >::Type Type ;
+	} ;
+} ;
+
+//! M^-1 block that solves with an already factorized band matrix
+/*! The factorization is not owned, and must outlive the block.
+	For dense matrices, compute() falls back to a dense LU
+*/
+struct BandSolver : public LinearSolverBase< BandSolver >
+{
+	typedef LinearSolverTraits< BandSolver > Traits ;
+
+	BandSolver() : m_band( 0 ) {}
+
+	//! Uses the existing band factorization \p band
+	BandSolver& compute( const Traits::FactType& band )
+	{
+		m_band = &band ;
+		return *this ;
+	}
+
+	template< typename OtherDerived >
+	BandSolver& compute( const Eigen::MatrixBase< OtherDerived >& mat )
+	{
+		m_band = 0 ;
+		m_dense.compute( mat ) ;
+		return *this ;
+	}
+
+	//! Whether this block refers to a band factorization ( which may be updated without calling compute() )
+	bool isBand() const { return m_band != 0 ; }
+
+	template < typename RhsT, typename ResT >
+	void solve( const Eigen::MatrixBase< RhsT >& rhs, ResT& res ) const
+	{
+		res = solve( rhs ) ;
+	}
+
+	template < typename RhsT >
+	typename Traits::template Result< Eigen::MatrixBase< RhsT > >::Type
+	solve( const Eigen::MatrixBase< RhsT >& rhs ) const
+	{
+		typename Traits::template Result< Eigen::MatrixBase< RhsT > >::Type res ;
+		if( m_band )
+		{
+			m_band->solve( res, rhs ) ;
+		} else {
+			res = m_dense.solve( rhs ) ;
+		}
+		return res ;
+	}
+
+private:
+	const Traits::FactType* m_band ;
+	Eigen::FullPivLU< Eigen::MatrixXd > m_dense ;
+} ;
+
+template < typename RhsT >
+Eigen::MatrixXd operator*( const BandSolver& solver, const Eigen::SparseMatrixBase< RhsT >& rhs )
+{
+	return solver.solve( Eigen::MatrixXd( rhs ) ) ;
+}
+
+template< typename RhsBlockT, bool TransposeLhs, bool TransposeRhs >
+struct BlockBlockProductTraits < BandSolver, RhsBlockT, TransposeLhs, TransposeRhs >
+{
+	typedef typename BlockBlockProductTraits < Eigen::MatrixXd, RhsBlockT, TransposeLhs, TransposeRhs >::ReturnType
+	ReturnType ;
+} ;
+
+} //namespace bogus
+
+#endif
@@ -71,7 +71,8 @@ void PrimalFrictionProblem< Dimension >::updateObjectLHS ( unsigned oId, Eigen::
 	updatedM.finalize() ;
 	M = updatedM;
 
-	MInv.block( oId ).compute( M.block( oId ) ) ;
+	// Band blocks share the factorization that has just been updated
+	if( !MInv.block( oId ).isBand() ) MInv.block( oId ).compute( M.block( oId ) ) ;
 	// recompute other values in dual that depend on M && MInv
 }
 
@@ -29,6 +29,8 @@
 #include "../Core/Utils/Signal.hpp"
 #include "../Core/ExternalForce.hh"
 
+#include "BandSolver.hpp"
+
 #include "../../hairSim/Utils/Definitions.h"
 
 
@@ -45,8 +47,9 @@ struct PrimalFrictionProblem
 	//! E -- local rotation matrix ( world <-> contact basis )
 	bogus::SparseBlockMatrix< Eigen::Matrix< double, Dimension, Dimension > > E ;
 
-	typedef Eigen::Matrix< double, Dimension, Eigen::Dynamic > HBlock ;
+	typedef Eigen::SparseMatrix< double, Eigen::RowMajor > HBlock ;
 	//! H -- deformation gradient ( generalized coordinates <-> 3D world )
+	/*! Blocks are sparse, as each contact only involves the dofs of a few vertices */
 	SparseBlockMatrix< HBlock, UNCOMPRESSED > H;
 
 	//! External forces
@@ -58,8 +61,8 @@ struct PrimalFrictionProblem
 
 	// Cached data
 
-	//! M^-1
-	SparseBlockMatrix< LU< Eigen::MatrixBase< Eigen::MatrixXd > > > MInv ;
+	//! M^-1 -- either the strands' band factorizations, or a dense LU of M
+	SparseBlockMatrix< BandSolver > MInv ;
 
 
     /*! Returns true if at least one force has been recomputed
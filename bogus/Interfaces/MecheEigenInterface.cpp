@@ -29,9 +29,14 @@
 #include "../Core/BlockSolvers/ProjectedGradient.hpp"
 #include "../Core/BlockSolvers/Coloring.impl.hpp"
 
+#include "../Extra/SecondOrder.impl.hpp"
+
 #include "../Core/Utils/Timer.hpp"
 
 #include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
 
 #include "../../hairSim/Utils/Definitions.h"
 #include "../../hairSim/Math/BandMatrixFwd.h"
@@ -47,13 +52,34 @@
 namespace bogus
 {
 
+//! Adds the non-zeros of A * H to triplets
+static void addJacobianTriplets( const DeformationGradient& H, const Eigen::Matrix3d& A,
+								 std::vector< Eigen::Triplet< double > >& triplets )
+{
+	for( int k = 0 ; k < 3 ; ++k )
+	{
+		for( int r = 0 ; r < 3 ; ++r )
+		{
+			triplets.push_back( Eigen::Triplet< double >( r, H.firstCol() + k, ( 1. - H.abscissa() ) * A( r, k ) ) ) ;
+			if( H.abscissa() > 0. )
+			{
+				triplets.push_back( Eigen::Triplet< double >( r, H.firstCol() + 4 + k, H.abscissa() * A( r, k ) ) ) ;
+			}
+		}
+	}
+}
+
 MecheFrictionProblem::MecheFrictionProblem(): 
 	m_primal( 0 ), 
 	m_dual( 0 ),
 	m_lastSolveTime( 0 ),
+	m_lastSolveIterations( 0 ),
 	m_f( 0 ), 
 	m_w( 0 ), 
 	m_mu( 0 ),
+	m_regularization( 0 ),
+	m_maxOuterIterations( 3 ),
+	m_outerTolerance( 1.e-3 ),
 	m_out( &std::cerr )
 {}
 
@@ -89,104 +115,167 @@ void MecheFrictionProblem::ackCurrentResidual( unsigned GSIter, double err )
 	m_callback.trigger( GSIter, err, m_timer.elapsed() );
 }
 
+void MecheFrictionProblem::ackOuterIteration( unsigned pass, double err )
+{
+	m_callback.trigger( pass, err, m_timer.elapsed() );
+}
+
+double MecheFrictionProblem::innerTolerance( const unsigned pass, const double tol ) const
+{
+	// Geometric interpolation from tol^(1/N) at the first pass to tol at the N-th one
+	return std::max( tol, std::pow( tol, ( pass + 1. ) / std::max( 1u, m_maxOuterIterations ) ) ) ;
+}
+
+double MecheFrictionProblem::relativeChange( const Eigen::VectorXd& prev, const Eigen::VectorXd& cur )
+{
+	return ( cur - prev ).norm() / std::max( prev.norm(), std::numeric_limits< double >::epsilon() ) ;
+}
+
 void MecheFrictionProblem::reset ()
 {
 	destroy() ;
 
 	m_primal = new PrimalFrictionProblem<3u>() ;
 	m_lastSolveTime = 0 ;
+	m_lastSolveIterations = 0 ;
 }
 
 
 void MecheFrictionProblem::fromPrimal
 	(
 		const unsigned int NObj, //!< number of subsystems
-		const std::vector<unsigned> ndof, //!< array of size \a NObj, the number of degree of freedom of each subsystem
-		const std::vector < SymmetricBandMatrixSolver<double, 10>* > MassMat, //!< the square ndof[i] long mass matrix of each subsystem
-		const Eigen::VectorXd f_in, //!< the constant term in \f$ M v + f= {}^t \! H r \f$
+		const std::vector<unsigned>& ndof, //!< array of size \a NObj, the number of degree of freedom of each subsystem
+		const std::vector < SymmetricBandMatrixSolver<double, 10>* >& MassMat, //!< the square ndof[i] long mass matrix of each subsystem
+		const Eigen::VectorXd& f_in, //!< the constant term in \f$ M v + f= {}^t \! H r \f$
 		const unsigned int n_in, //!< number of contact points
-		const Eigen::VectorXd mu_in, //!< array of size \a n giving the friction coeffs
-		const std::vector < Eigen::Matrix< double, 3, 3 > > E_in, // E matrix with form: 3*n_in x 3, !< array of size \f$ n \times d \times d \f$ giving the \a n normals followed by the \a n tangent vectors (and by again \a n tangent vectors if \a d is 3). Said otherwise, \a E is a \f$ (nd) \times d \f$ matrix, stored column-major, formed by \a n blocks of size \f$ d \times d \f$ with each block being an orthogonal matrix (the transition matrix from the world space coordinates \f$ (x_1, x_2, x_3) \f$ to the local coordinates \f$ (x_N, x_{T1}, x_{T2}) \f$
-		const Eigen::VectorXd w_in, //!< array of size \a nd, the constant term in \f$ u = H v + w \f$
+		const Eigen::VectorXd& mu_in, //!< array of size \a n giving the friction coeffs
+		const std::vector < Eigen::Matrix< double, 3, 3 > >& E_in, // E matrix with form: 3*n_in x 3, !< array of size \f$ n \times d \times d \f$ giving the \a n normals followed by the \a n tangent vectors (and by again \a n tangent vectors if \a d is 3). Said otherwise, \a E is a \f$ (nd) \times d \f$ matrix, stored column-major, formed by \a n blocks of size \f$ d \times d \f$ with each block being an orthogonal matrix (the transition matrix from the world space coordinates \f$ (x_1, x_2, x_3) \f$ to the local coordinates \f$ (x_N, x_{T1}, x_{T2}) \f$
+		const Eigen::VectorXd& w_in, //!< array of size \a nd, the constant term in \f$ u = H v + w \f$
 		const int * const ObjA, //!< array of size \a n, the first object involved in the \a i-th contact (must be an internal object) (counted from 0)
 		const int * const ObjB, //!< array of size \a n, the second object involved in the \a i-th contact (-1 for an external object) (counted from 0)
-		const std::vector < SparseRowMatx* > HA, //!< array of size \a n, containing pointers to a dense, colum-major matrix of size <c> d*ndof[ObjA[i]] </c> corresponding to the H-matrix of <c> ObjA[i] </c>
-		const std::vector < SparseRowMatx* > HB, //!< array of size \a n, containing pointers to a dense, colum-major matrix of size <c> d*ndof[ObjA[i]] </c> corresponding to the H-matrix of <c> ObjB[i] </c> (\c NULL for an external object)
-		const std::vector < unsigned > dofIndices
+		const std::vector < const DeformationGradient* >& HA, //!< array of size \a n, containing pointers to the deformation gradient of <c> ObjA[i] </c> at the \a i-th contact
+		const std::vector < const DeformationGradient* >& HB, //!< array of size \a n, containing pointers to the deformation gradient of <c> ObjB[i] </c> at the \a i-th contact (\c NULL for an external object)
+		const std::vector < unsigned >& dofIndices
 	)
 {
-	reset();
+	assert( NObj == ndof.size() );
+	assert( HA.size() == HB.size() );
+	assert( HA.size() == n_in );
 
-	// Copy M
-	// We don't actually need it after having computed a factorization of M, but we keep it around
-	// in case we want to use dumpToFile()
+	beginPrimal( ndof, n_in, dofIndices ) ;
 
-	assert( NObj == ndof.size() );
+	for( unsigned i = 0 ; i < NObj ; ++i )
+	{
+		setObject( i, *MassMat[i], f_in.segment( dofIndices[i], ndof[i] ) ) ;
+	}
+
+#ifndef BOGUS_DONT_PARALLELIZE
+#pragma omp parallel for
+#endif
+	for( std::ptrdiff_t i = 0 ; i < (std::ptrdiff_t) n_in ; ++i )
+	{
+		setContact( i, mu_in[i], E_in[i], ObjA[i], ObjB[i], HA[i], HB[i] ) ;
+	}
+
+	finalizePrimal() ;
 
+	m_primal->w = w_in ;
+}
+
+void MecheFrictionProblem::beginPrimal(
+		const std::vector<unsigned>& ndof,
+		const unsigned int n_in,
+		const std::vector < unsigned >& dofIndices
+		)
+{
+	reset();
+
+	// Only the block structure of M is set up, M^-1 directly uses
+	// the band factorizations given to setObject()
+	const unsigned NObj = ndof.size() ;
 	m_primal->M.reserve( NObj ) ;
 	m_primal->M.setRows( ndof ) ;
 	m_primal->M.setCols( ndof ) ;
-	ndofOr = ndof;
-
 	for( unsigned i = 0 ; i < NObj ; ++i )
 	{
-
-		Eigen::MatrixXd M( MassMat[i]->matrix().rows(), MassMat[i]->matrix().cols() );
-		for( int r = 0; r < M.rows(); ++r ){
-			for( int c= 0; c < M.cols(); ++c ){
-				M(r,c) = MassMat[i]->matrix()(r,c);
-			}
-		}
-		// std::cout << "M[" << i << "]: " << M.rows() << " x " << M.cols() << std::endl;
-		m_primal->M.insertBack( i, i ) = M;
-        // std::cout << "Bogus MassMat: " << M << std::endl;
+		m_primal->M.insertBack( i, i ) ;
 	}
 	m_primal->M.finalize() ;
+	m_primal->MInv.cloneStructure( m_primal->M ) ;
+	ndofOr = ndof;
 
-	// E
+	// E is block-diagonal, its structure is known beforehand
 	m_primal->E.reserve( n_in ) ;
 	m_primal->E.setRows( n_in ) ;
 	m_primal->E.setCols( n_in ) ;
 	for( unsigned i = 0 ; i < n_in ; ++i )
 	{
-		m_primal->E.insertBack( i, i ) = E_in[i];
+		m_primal->E.insertBack( i, i ) ;
 	}
 	m_primal->E.finalize() ;
-	m_primal->E.cacheTranspose() ;
-
-	assert( HA.size() == HB.size() );
-	assert( HA.size() == n_in );
 
-	// Build H
 	m_primal->H.reserve( 2*n_in ) ;
 	m_primal->H.setRows( n_in ) ;
 	m_primal->H.setCols( ndof ) ;
-#ifndef BOGUS_DONT_PARALLELIZE
-#pragma omp parallel for
-#endif
-	for( std::ptrdiff_t i = 0 ; i < (std::ptrdiff_t) n_in ; ++i )
+
+	const unsigned m = m_primal->M.rows() ;
+	m_primal->f.setZero( m ) ;
+	m_primal->w.setZero( 3*n_in ) ;
+	m_primal->mu.setZero( n_in ) ;
+	m_dofIndices = dofIndices;
+
+	m_contactGradients.resize( n_in ) ;
+	m_updatedObjects.assign( NObj, 0 ) ;
+	m_updatedContacts.assign( n_in, 0 ) ;
+	m_additionalForces.setZero( m ) ;
+}
+
+void MecheFrictionProblem::setObject( const unsigned oId, const SymmetricBandMatrixSolver<double, 10>& MassMat, const Eigen::VectorXd& f )
+{
+	m_primal->MInv.diagonal( oId ).compute( MassMat ) ;
+	m_primal->f.segment( m_dofIndices[oId], f.size() ) = f ;
+}
+
+void MecheFrictionProblem::setContact( const unsigned cId, const double mu, const Eigen::Matrix< double, 3, 3 >& E,
+									   const int ObjA, const int ObjB, const DeformationGradient* HA, const DeformationGradient* HB )
+{
+	m_primal->E.diagonal( cId ) = E ;
+	m_primal->mu[ cId ] = mu ;
+
+	ContactGradients& gradients = m_contactGradients[ cId ] ;
+	gradients.objA = ObjA ;
+	gradients.objB = ObjB ;
+	gradients.HA = *HA ;
+	if( HB ) gradients.HB = *HB ;
+
+	// H is still used by the generic products, e.g. updateExternalForces()
+	// Concurrent insertions in distinct rows are safe
+	const Eigen::Matrix3d Et = E.transpose() ;
+	std::vector< Eigen::Triplet< double > > triplets ;
+	addJacobianTriplets( *HA, Et, triplets ) ;
+	if( ObjB == ObjA )
 	{
-		const Eigen::Matrix3d Et = m_primal->E.diagonal(i).transpose() ;
+		addJacobianTriplets( *HB, -Et, triplets ) ;
+	}
+	else if( ObjB != -1 )
+	{
+		std::vector< Eigen::Triplet< double > > tripletsB ;
+		addJacobianTriplets( *HB, -Et, tripletsB ) ;
 
-		if( ObjB[i] == -1 )
-		{
-			m_primal->H.insert( i, ObjA[i] ) =  Et * Eigen::MatrixXd( *HA[i] ) ;
-		} 
-		else if( ObjB[i] == ObjA[i] )
-		{
-			m_primal->H.insert( i, ObjA[i] ) =  Et * ( Eigen::MatrixXd( *HA[i] ) - Eigen::MatrixXd( *HB[i] ) ) ;
-		}
-		else {
-			m_primal->H.insert( i, ObjA[i] ) =    Et * Eigen::MatrixXd( *HA[i] ) ;
-			m_primal->H.insert( i, ObjB[i] ) =  - Et * Eigen::MatrixXd( *HB[i] ) ;
-		}
+		PrimalFrictionProblem<3u>::HBlock& HblockB = m_primal->H.insert( cId, ObjB ) ;
+		HblockB.resize( 3, HB->cols() ) ;
+		HblockB.setFromTriplets( tripletsB.begin(), tripletsB.end() ) ;
 	}
-	m_primal->H.finalize() ;
 
-	m_primal->f = f_in ;
-	m_primal->w = w_in ;
-	m_primal->mu = mu_in ;
-	m_dofIndices = dofIndices;
+	PrimalFrictionProblem<3u>::HBlock& HblockA = m_primal->H.insert( cId, ObjA ) ;
+	HblockA.resize( 3, HA->cols() ) ;
+	HblockA.setFromTriplets( triplets.begin(), triplets.end() ) ;
+}
+
+void MecheFrictionProblem::finalizePrimal()
+{
+	m_primal->E.cacheTranspose() ;
+	m_primal->H.finalize() ;
 }
 
 unsigned MecheFrictionProblem::nDegreesOfFreedom() const
@@ -203,7 +292,14 @@ void MecheFrictionProblem::computeDual( double regularization )
 {
 	delete m_dual ;
 	m_dual = new DualFrictionProblem<3u>() ;
-	m_dual->computeFrom( *m_primal );
+
+	// M^-1 has been set up by setObject()
+	computeDelassus() ;
+	computeDualRhs() ;
+	m_dual->mu = m_primal->mu ;
+	m_regularization = regularization ;
+	std::fill( m_updatedObjects.begin(), m_updatedObjects.end(), 0 ) ;
+	std::fill( m_updatedContacts.begin(), m_updatedContacts.end(), 0 ) ;
 
 	if( regularization > 0. )
 	{
@@ -211,6 +307,469 @@ void MecheFrictionProblem::computeDual( double regularization )
 	}
 }
 
+void MecheFrictionProblem::computeObjectContacts()
+{
+	const std::ptrdiff_t n = m_contactGradients.size() ;
+
+	m_objectContacts.assign( m_primal->M.rowsOfBlocks(), std::vector< std::pair< unsigned, unsigned > >() ) ;
+	for( std::ptrdiff_t i = 0 ; i < n ; ++i )
+	{
+		const ContactGradients& c = m_contactGradients[i] ;
+		m_objectContacts[ c.objA ].push_back( std::make_pair( i, 0u ) ) ;
+		if( c.objB != -1 ) m_objectContacts[ c.objB ].push_back( std::make_pair( i, 1u ) ) ;
+	}
+}
+
+void MecheFrictionProblem::computeDelassus()
+{
+	const std::ptrdiff_t n = m_contactGradients.size() ;
+
+	computeObjectContacts() ;
+
+	m_MInvHt.resize( 2*n ) ;
+#ifndef BOGUS_DONT_PARALLELIZE
+#pragma omp parallel for
+#endif
+	for( std::ptrdiff_t i = 0 ; i < n ; ++i )
+	{
+		computeMInvHt( i, 0 ) ;
+		if( m_contactGradients[i].objB != -1 ) computeMInvHt( i, 1 ) ;
+	}
+
+	// Lower triangle of W, row by row. Since H is only non-zero on a few dofs,
+	// W_ij = E_i^T ( H_i M^-1 H_j^T ) E_j only needs a few rows of M^-1 H_j^T
+	typedef std::map< std::ptrdiff_t, Eigen::Matrix3d > Row ;
+	std::vector< Row > rows( n ) ;
+#ifndef BOGUS_DONT_PARALLELIZE
+#pragma omp parallel for
+#endif
+	for( std::ptrdiff_t i = 0 ; i < n ; ++i )
+	{
+		const ContactGradients& ci = m_contactGradients[i] ;
+		Row& row = rows[i] ;
+		for( unsigned a = 0 ; a < 2 ; ++a )
+		{
+			const int obj = a ? ci.objB : ci.objA ;
+			if( obj == -1 ) continue ;
+			const DeformationGradient& Hi = a ? ci.HB : ci.HA ;
+
+			const std::vector< std::pair< unsigned, unsigned > >& contacts = m_objectContacts[ obj ] ;
+			for( unsigned k = 0 ; k < contacts.size() ; ++k )
+			{
+				const std::ptrdiff_t j = contacts[k].first ;
+				if( j > i ) continue ;
+				const unsigned b = contacts[k].second ;
+
+				const Eigen::Matrix3d HMInvHt = Hi.multiply( m_MInvHt[ 2*j+b ] ) ;
+				Row::iterator block = row.find( j ) ;
+				if( block == row.end() ) block = row.insert( std::make_pair( j, Eigen::Matrix3d::Zero() ) ).first ;
+				if( a == b ) block->second += HMInvHt ;
+				else         block->second -= HMInvHt ;
+			}
+		}
+		for( Row::iterator block = row.begin() ; block != row.end() ; ++block )
+		{
+			block->second = m_primal->E.diagonal( i ).transpose() * block->second * m_primal->E.diagonal( block->first ) ;
+		}
+	}
+
+	std::size_t nBlocks = 0 ;
+	for( std::ptrdiff_t i = 0 ; i < n ; ++i )
+	{
+		nBlocks += rows[i].size() ;
+	}
+
+	DualFrictionProblem<3u>::WType& W = m_dual->W ;
+	W.clear() ;
+	W.setRows( n ) ;
+	W.reserve( nBlocks ) ;
+	for( std::ptrdiff_t i = 0 ; i < n ; ++i )
+	{
+		for( Row::const_iterator block = rows[i].begin() ; block != rows[i].end() ; ++block )
+		{
+			W.insertBack( i, block->first ) = block->second ;
+		}
+	}
+	W.finalize() ;
+}
+
+void MecheFrictionProblem::computeDualRhs()
+{
+	const std::ptrdiff_t n = m_contactGradients.size() ;
+	m_MInvf = m_primal->MInv * m_primal->f ;
+
+	m_dual->b.resize( 3*n ) ;
+#ifndef BOGUS_DONT_PARALLELIZE
+#pragma omp parallel for
+#endif
+	for( std::ptrdiff_t i = 0 ; i < n ; ++i )
+	{
+		m_dual->b.segment< 3 >( 3*i ) = dualRhs( i ) ;
+	}
+}
+
+void MecheFrictionProblem::computeMInvHt( const std::ptrdiff_t cId, const unsigned side )
+{
+	const ContactGradients& c = m_contactGradients[ cId ] ;
+	Eigen::MatrixXd Ht ;
+	( side ? c.HB : c.HA ).transposeTo( Ht ) ;
+	m_primal->MInv.block( side ? c.objB : c.objA ).solve( Ht, m_MInvHt[ 2*cId+side ] ) ;
+}
+
+Eigen::Matrix3d MecheFrictionProblem::delassusBlock( const std::ptrdiff_t i, const std::ptrdiff_t j ) const
+{
+	const ContactGradients& ci = m_contactGradients[i] ;
+	const ContactGradients& cj = m_contactGradients[j] ;
+
+	Eigen::Matrix3d Wij = Eigen::Matrix3d::Zero() ;
+	for( unsigned a = 0 ; a < 2 ; ++a )
+	{
+		const int obj = a ? ci.objB : ci.objA ;
+		if( obj == -1 ) continue ;
+		const DeformationGradient& Hi = a ? ci.HB : ci.HA ;
+
+		for( unsigned b = 0 ; b < 2 ; ++b )
+		{
+			if( ( b ? cj.objB : cj.objA ) != obj ) continue ;
+
+			const Eigen::Matrix3d HMInvHt = Hi.multiply( m_MInvHt[ 2*j+b ] ) ;
+			if( a == b ) Wij += HMInvHt ;
+			else         Wij -= HMInvHt ;
+		}
+	}
+	return m_primal->E.diagonal( i ).transpose() * Wij * m_primal->E.diagonal( j ) ;
+}
+
+Eigen::Vector3d MecheFrictionProblem::dualRhs( const std::ptrdiff_t i ) const
+{
+	const ContactGradients& c = m_contactGradients[i] ;
+	Eigen::Vector3d HMInvf = c.HA.multiply( m_MInvf.segment( m_dofIndices[ c.objA ], ndofOr[ c.objA ] ) ) ;
+	if( c.objB != -1 )
+	{
+		HMInvf -= c.HB.multiply( m_MInvf.segment( m_dofIndices[ c.objB ], ndofOr[ c.objB ] ) ) ;
+	}
+	return m_primal->E.diagonal( i ).transpose() * ( m_primal->w.segment< 3 >( 3*i ) - HMInvf ) ;
+}
+
+void MecheFrictionProblem::updateDual()
+{
+	if( !m_dual ) return ;
+
+	std::vector< unsigned > objects ;
+	for( unsigned o = 0 ; o < m_updatedObjects.size() ; ++o )
+	{
+		if( m_updatedObjects[o] ) objects.push_back( o ) ;
+	}
+
+	const std::ptrdiff_t n = m_contactGradients.size() ;
+	std::vector< char > updatedContacts( n, 0 ) ;
+	std::vector< std::ptrdiff_t > contacts ;
+	std::vector< std::ptrdiff_t > rhsContacts ;
+	for( unsigned k = 0 ; k < objects.size() ; ++k )
+	{
+		const unsigned o = objects[k] ;
+		m_MInvf.segment( m_dofIndices[o], ndofOr[o] ) =
+				m_primal->MInv.block( o ).solve( m_primal->f.segment( m_dofIndices[o], ndofOr[o] ) ) ;
+		m_updatedObjects[o] = 0 ;
+
+		for( unsigned c = 0 ; c < m_objectContacts[o].size() ; ++c )
+		{
+			const unsigned i = m_objectContacts[o][c].first ;
+			if( !updatedContacts[i] ) contacts.push_back( i ) ;
+			updatedContacts[i] = 1 ;
+		}
+	}
+
+	// Contacts for which only w changed
+	for( std::ptrdiff_t i = 0 ; i < n ; ++i )
+	{
+		if( m_updatedContacts[i] && !updatedContacts[i] ) rhsContacts.push_back( i ) ;
+		m_updatedContacts[i] = 0 ;
+	}
+	if( contacts.empty() && rhsContacts.empty() ) return ;
+
+	// W and b may have been permuted by the coloring
+	DualFrictionProblem<3u>::WType& W = m_dual->W ;
+	const bool permuted = m_dual->permuted() ;
+	const std::vector< std::size_t >& invPerm = m_dual->invPermutation() ;
+
+	// Only the lower triangle is stored. Blocks between two updated contacts
+	// are computed by the one with the greatest row, so that each is written once
+#ifndef BOGUS_DONT_PARALLELIZE
+#pragma omp parallel for
+#endif
+	for( std::ptrdiff_t k = 0 ; k < (std::ptrdiff_t) contacts.size() ; ++k )
+	{
+		const std::ptrdiff_t i = contacts[k] ;
+		const std::ptrdiff_t pi = permuted ? invPerm[i] : i ;
+
+		std::vector< std::ptrdiff_t > neighbours ;
+		const ContactGradients& ci = m_contactGradients[i] ;
+		for( unsigned a = 0 ; a < 2 ; ++a )
+		{
+			const int obj = a ? ci.objB : ci.objA ;
+			if( obj == -1 ) continue ;
+			for( unsigned c = 0 ; c < m_objectContacts[obj].size() ; ++c )
+			{
+				neighbours.push_back( m_objectContacts[obj][c].first ) ;
+			}
+		}
+		std::sort( neighbours.begin(), neighbours.end() ) ;
+		neighbours.erase( std::unique( neighbours.begin(), neighbours.end() ), neighbours.end() ) ;
+
+		for( unsigned c = 0 ; c < neighbours.size() ; ++c )
+		{
+			const std::ptrdiff_t j = neighbours[c] ;
+			const std::ptrdiff_t pj = permuted ? invPerm[j] : j ;
+			if( pj > pi && updatedContacts[j] ) continue ;
+
+			Eigen::Matrix3d Wij = delassusBlock( i, j ) ;
+			if( i == j ) Wij.diagonal().array() += m_regularization ;
+
+			if( pj > pi )
+			{
+				W.block( W.blockPtr( pj, pi ) ) = Wij.transpose() ;
+				W.updateTransposedBlock( pj, pi ) ;
+			} else {
+				W.block( W.blockPtr( pi, pj ) ) = Wij ;
+				W.updateTransposedBlock( pi, pj ) ;
+			}
+		}
+
+		m_dual->b.segment< 3 >( 3*pi ) = dualRhs( i ) ;
+	}
+
+#ifndef BOGUS_DONT_PARALLELIZE
+#pragma omp parallel for
+#endif
+	for( std::ptrdiff_t k = 0 ; k < (std::ptrdiff_t) rhsContacts.size() ; ++k )
+	{
+		const std::ptrdiff_t i = rhsContacts[k] ;
+		m_dual->b.segment< 3 >( 3*( permuted ? invPerm[i] : i ) ) = dualRhs( i ) ;
+	}
+}
+
+void MecheFrictionProblem::contactForces( const Eigen::VectorXd& r, Eigen::VectorXd& res ) const
+{
+	res.setZero( m_primal->M.rows() ) ;
+	for( unsigned i = 0 ; i < m_contactGradients.size() ; ++i )
+	{
+		const ContactGradients& c = m_contactGradients[i] ;
+		const Eigen::Vector3d r_world = m_primal->E.diagonal( i ) * r.segment< 3 >( 3*i ) ;
+		c.HA.addTransposeMultiply( r_world, res, m_dofIndices[ c.objA ] ) ;
+		if( c.objB != -1 )
+		{
+			c.HB.addTransposeMultiply( -r_world, res, m_dofIndices[ c.objB ] ) ;
+		}
+	}
+}
+
+Eigen::Matrix3d MecheFrictionProblem::diagonalDelassusBlock( const std::ptrdiff_t i ) const
+{
+	const ContactGradients& c = m_contactGradients[i] ;
+
+	Eigen::Matrix3d Wii = Eigen::Matrix3d::Zero() ;
+	Eigen::MatrixXd Ht, MInvHt ;
+	for( unsigned a = 0 ; a < 2 ; ++a )
+	{
+		const int obj = a ? c.objB : c.objA ;
+		if( obj == -1 ) continue ;
+		const DeformationGradient& H = a ? c.HB : c.HA ;
+
+		H.transposeTo( Ht ) ;
+		m_primal->MInv.block( obj ).solve( Ht, MInvHt ) ;
+		Wii += H.multiply( MInvHt ) ;
+	}
+	return m_primal->E.diagonal( i ).transpose() * Wii * m_primal->E.diagonal( i ) ;
+}
+
+void MecheFrictionProblem::dualVelocities( const Eigen::VectorXd& r, Eigen::VectorXd& u ) const
+{
+	Eigen::VectorXd forces ;
+	contactForces( r, forces ) ;
+	const Eigen::VectorXd vel = m_primal->MInv * ( forces - m_primal->f ) ;
+
+	const std::ptrdiff_t n = m_contactGradients.size() ;
+	u.resize( 3*n ) ;
+#ifndef BOGUS_DONT_PARALLELIZE
+#pragma omp parallel for
+#endif
+	for( std::ptrdiff_t i = 0 ; i < n ; ++i )
+	{
+		const ContactGradients& c = m_contactGradients[i] ;
+		Eigen::Vector3d Hv = c.HA.multiply( vel.segment( m_dofIndices[ c.objA ], ndofOr[ c.objA ] ) ) ;
+		if( c.objB != -1 )
+		{
+			Hv -= c.HB.multiply( vel.segment( m_dofIndices[ c.objB ], ndofOr[ c.objB ] ) ) ;
+		}
+		u.segment< 3 >( 3*i ) = m_primal->E.diagonal( i ).transpose() * ( Hv + m_primal->w.segment< 3 >( 3*i ) ) ;
+	}
+}
+
+double MecheFrictionProblem::solveJacobi( Eigen::VectorXd& r, const double tol, const unsigned maxIters, const bool useInfinityNorm )
+{
+	typedef DualFrictionProblem< 3u >::CoulombLawType LawType ;
+
+	const std::ptrdiff_t n = m_contactGradients.size() ;
+	const LawType law( n, m_primal->mu.data() ) ;
+
+	Eigen::VectorXd scaling( n ) ;
+	for( std::ptrdiff_t i = 0 ; i < n ; ++i )
+	{
+		scaling[i] = std::max( 1., m_diagonalBlocks[i].trace() ) ;
+	}
+
+	Eigen::VectorXd u, r_prev, r_best, u_best ;
+	dualVelocities( r, u ) ;
+
+	double res = 0. ;
+	for( std::ptrdiff_t i = 0 ; i < n ; ++i )
+	{
+		const double lres = law.eval( i, scaling[i] * r.segment< 3 >( 3*i ), u.segment< 3 >( 3*i ) ) ;
+		res = useInfinityNorm ? std::max( res, lres ) : res + lres ;
+	}
+	if( !useInfinityNorm && n ) res /= n ;
+
+	r_best = r ;
+	u_best = u ;
+	double res_best = res ;
+
+	// All contacts are updated at once from the same u, which overshoots when they are strongly coupled.
+	// The damping is halved each time the residual increases, and slowly relaxed back otherwise
+	double omega = 1. ;
+
+	unsigned iter ;
+	for( iter = 0 ; iter < maxIters && res_best >= tol && omega > 1.e-3 ; ++iter )
+	{
+		r_prev = r ;
+
+#ifndef BOGUS_DONT_PARALLELIZE
+#pragma omp parallel for
+#endif
+		for( std::ptrdiff_t i = 0 ; i < n ; ++i )
+		{
+			LawType::Traits::Vector lx = r_prev.segment< 3 >( 3*i ) ;
+			const LawType::Traits::Vector lb = u.segment< 3 >( 3*i ) - m_diagonalBlocks[i] * lx ;
+			if( !law.solveLocal( i, m_diagonalBlocks[i], lb, lx, scaling[i] ) )
+			{
+				lx = .5 * ( lx + r_prev.segment< 3 >( 3*i ) ) ;
+			}
+			r.segment< 3 >( 3*i ) = ( 1. - omega ) * r_prev.segment< 3 >( 3*i ) + omega * lx ;
+		}
+
+		dualVelocities( r, u ) ;
+
+		res = 0. ;
+		for( std::ptrdiff_t i = 0 ; i < n ; ++i )
+		{
+			const double lres = law.eval( i, scaling[i] * r.segment< 3 >( 3*i ), u.segment< 3 >( 3*i ) ) ;
+			res = useInfinityNorm ? std::max( res, lres ) : res + lres ;
+		}
+		if( !useInfinityNorm && n ) res /= n ;
+
+		// Not ackCurrentResidual(), which would log each iteration of the concurrent group solves
+		m_callback.trigger( iter, res, m_timer.elapsed() ) ;
+
+		if( res < res_best )
+		{
+			res_best = res ;
+			r_best = r ;
+			u_best = u ;
+			omega = std::min( 1., 1.25 * omega ) ;
+		} else {
+			r = r_best ;
+			u = u_best ;
+			omega *= .5 ;
+		}
+	}
+
+	m_lastSolveIterations += iter ;
+	r = r_best ;
+
+	return res_best ;
+}
+
+double MecheFrictionProblem::solveMatrixFree(
+		Eigen::VectorXd& r, //!< length \a nd : initialization for \a r (in world space coordinates) + used to return computed r
+		Eigen::VectorXd& v, //!< length \a m: to return computed v
+		const double tol, //!< Jacobi tolerance. 0. means 1.e-6
+		const unsigned maxIters, //!< Max number of Jacobi iterations. 0 means 500
+		const bool useInfinityNorm //!< Whether to use the infinity norm to evaluate the residual of the friction problem
+		)
+{
+	assert( m_primal ) ;
+	const std::ptrdiff_t n = m_contactGradients.size() ;
+	assert( r.size() == 3 * n );
+
+	m_timer.reset();
+
+	// No W nor M^-1 H^T is kept, only the 3x3 diagonal blocks
+	computeObjectContacts() ;
+	m_diagonalBlocks.resize( n ) ;
+#ifndef BOGUS_DONT_PARALLELIZE
+#pragma omp parallel for
+#endif
+	for( std::ptrdiff_t i = 0 ; i < n ; ++i )
+	{
+		m_diagonalBlocks[i] = diagonalDelassusBlock( i ) ;
+	}
+	std::fill( m_updatedObjects.begin(), m_updatedObjects.end(), 0 ) ;
+	std::fill( m_updatedContacts.begin(), m_updatedContacts.end(), 0 ) ;
+
+	Eigen::VectorXd r_loc = m_primal->E.transpose() * r ;
+	Eigen::VectorXd forces ;
+
+	double res = -1 ;
+
+	// Same inexact outer loop with updateExternalForces as solve()
+	const double finalTol = tol != 0. ? tol : 1.e-6 ;
+	bool converged = !m_primal->hasExternalForces() ;
+	m_lastSolveIterations = 0 ;
+	for( unsigned pass = 0 ; ; ++pass )
+	{
+		const bool lastPass = converged || pass + 1 >= m_maxOuterIterations ;
+		const double passTol = lastPass ? finalTol : innerTolerance( pass, finalTol ) ;
+
+		res = solveJacobi( r_loc, passTol, maxIters != 0 ? maxIters : 500, useInfinityNorm ) ;
+		if( lastPass )
+		{
+			ackOuterIteration( pass, res ) ;
+			break ;
+		}
+
+		contactForces( r_loc, forces ) ;
+		v = m_primal->MInv * ( forces - m_primal->f ) ;
+		const Eigen::VectorXd fPrev = m_primal->f ;
+		const bool updated = m_primal->updateExternalForces( v, r_loc, m_dofIndices );
+
+		// f and w are read directly by dualVelocities(), only the diagonal blocks need refreshing
+		for( unsigned o = 0 ; o < m_updatedObjects.size() ; ++o )
+		{
+			if( !m_updatedObjects[o] ) continue ;
+			m_updatedObjects[o] = 0 ;
+			for( unsigned c = 0 ; c < m_objectContacts[o].size() ; ++c )
+			{
+				m_diagonalBlocks[ m_objectContacts[o][c].first ] = diagonalDelassusBlock( m_objectContacts[o][c].first ) ;
+			}
+		}
+		std::fill( m_updatedContacts.begin(), m_updatedContacts.end(), 0 ) ;
+
+		const double change = updated ? relativeChange( fPrev, m_primal->f ) : 0. ;
+		ackOuterIteration( pass, res ) ;
+
+		converged = change < m_outerTolerance ;
+	}
+
+	m_lastSolveTime = m_timer.elapsed() ;
+
+	contactForces( r_loc, forces ) ;
+	v = m_primal->MInv * ( forces - m_primal->f ) ;
+
+	r = m_primal->E * r_loc ;
+
+	return res ;
+}
+
 // Eigen::VectorXd delassae;
 
 double MecheFrictionProblem::solve(
@@ -234,12 +793,15 @@ double MecheFrictionProblem::solve(
 	if( !m_dual )
 	{
 		computeDual( staticProblem ? regularization : 0. );
+	} else {
+		updateDual() ;
 	}
 
 	// r to local coords
 	assert( r.size() == 3 * n );
 	assert( v.size() == m );
 	Eigen::VectorXd r_loc = m_primal->E.transpose() * r ; //Eigen::VectorXd::Map( r, 3*n ) ;
+	Eigen::VectorXd forces ;
 
 	Signal< unsigned, double > callback ;
 	callback.connect( *this, &MecheFrictionProblem::ackCurrentResidual );
@@ -248,31 +810,29 @@ double MecheFrictionProblem::solve(
 
 	// Proper solving
 	m_timer.reset();
+
+	const bool useCadoux = !staticProblem && cadouxIters > 0 ;
+
+	DualFrictionProblem< 3u >::ProjectedGradientType pg ;
+	bogus::DualFrictionProblem<3u>::GaussSeidelType gs ;
+
 	if( useProjectedGradient ) {
 
-		DualFrictionProblem< 3u >::ProjectedGradientType pg ;
 		if( tol != 0. ) pg.setTol( tol );
 		if( maxIters != 0 ) pg.setMaxIters( maxIters );
 		pg.useInfinityNorm( useInfinityNorm ) ;
+		pg.setDefaultVariant( projected_gradient::APGD ) ;
 
-		if( staticProblem || cadouxIters == 0 )
+		if( !staticProblem && !useCadoux )
 		{
-			if( !staticProblem )
-			{
-				if( m_out )
-					*m_out << "Cannot solve a friction problem with a ProjectedGradient!" << std::endl ;
-				return -1 ;
-			}
-
-			pg.callback().connect( callback );
-			res = m_dual->solveWith( pg, r_loc.data() ) ;
-		} else {
-			res = m_dual->solveCadoux( pg, r_loc.data(), cadouxIters, &callback ) ;
+			if( m_out )
+				*m_out << "Cannot solve a friction problem with a ProjectedGradient!" << std::endl ;
+			return -1 ;
 		}
+
+		if( !useCadoux ) pg.callback().connect( callback );
 	} else {
 		// Setup GS parameters
-		bogus::DualFrictionProblem<3u>::GaussSeidelType gs ;
-
 		if( tol != 0. ) gs.setTol( tol );
 		if( maxIters != 0 ) gs.setMaxIters( maxIters );
 
@@ -280,6 +840,9 @@ double MecheFrictionProblem::solve(
 		gs.setAutoRegularization( regularization ) ;
 		gs.useInfinityNorm( useInfinityNorm ) ;
 
+		// A warm-started solve is expected to converge early, check the residual more often
+		if( !r.isZero() ) gs.setEvalEvery( 10 ) ;
+
 		const bool useColoring = maxThreads > 1 ;
 		gs.coloring().update( useColoring, m_dual->W );
 
@@ -291,35 +854,57 @@ double MecheFrictionProblem::solve(
 		}
 		m_dual->W.cacheTranspose() ;
 
-		if( staticProblem || cadouxIters == 0 )
-		{
-			gs.callback().connect( callback );
+		if( !useCadoux ) gs.callback().connect( callback );
+	}
 
-			// right here, we wrap this in a loop with updateExternalForces
-			unsigned iter = 0;
-			unsigned globalMaxIter = 4;
-			bool done = false;
-			do
-			{
-				done = ++iter == globalMaxIter;
-				if( !done )
-				{
-					res = m_dual->solveWith( gs, r_loc.data(), staticProblem ) ;
-	            	v = m_primal->MInv * ( m_primal->H.transpose() * r_loc - m_primal->f ) ;
-                    done = !m_primal->updateExternalForces( v, r_loc, m_dofIndices );					
-				}
-			} while( !done );
+	// Inexact outer loop with updateExternalForces: early passes are solved loosely,
+	// each one starting from the previous impulses, and the last one to the requested tolerance
+	const double finalTol = useProjectedGradient ? pg.tol() : gs.tol() ;
+	bool converged = !m_primal->hasExternalForces() ;
+	m_lastSolveIterations = 0 ;
+	for( unsigned pass = 0 ; ; ++pass )
+	{
+		const bool lastPass = converged || pass + 1 >= m_maxOuterIterations ;
+		const double passTol = lastPass ? finalTol : innerTolerance( pass, finalTol ) ;
+
+		if( useProjectedGradient )
+		{
+			pg.setTol( passTol ) ;
+			res = useCadoux ? m_dual->solveCadoux( pg, r_loc.data(), cadouxIters, &callback )
+							: m_dual->solveWith( pg, r_loc.data() ) ;
+			m_lastSolveIterations += pg.lastIterations() ;
+		} else {
+			gs.setTol( passTol ) ;
+			if( pass > 0 ) gs.setEvalEvery( 10 ) ;
 
+			res = useCadoux ? m_dual->solveCadoux( gs, r_loc.data(), cadouxIters, &callback )
+							: m_dual->solveWith( gs, r_loc.data(), staticProblem ) ;
+			m_lastSolveIterations += gs.lastIterations() ;
 		}
-		else {
-			res = m_dual->solveCadoux( gs, r_loc.data(), cadouxIters, &callback ) ;
+		if( lastPass )
+		{
+			ackOuterIteration( pass, res ) ;
+			break ;
 		}
 
+		contactForces( r_loc, forces ) ;
+		v = m_primal->MInv * ( forces - m_primal->f ) ;
+		const Eigen::VectorXd fPrev = m_primal->f ;
+		const bool updated = m_primal->updateExternalForces( v, r_loc, m_dofIndices );
+		updateDual() ;
+
+		const double change = updated ? relativeChange( fPrev, m_primal->f ) : 0. ;
+		ackOuterIteration( pass, res ) ;
+
+		// Once the external forces have settled, a last pass brings the loose impulses to the final tolerance
+		converged = change < m_outerTolerance ;
 	}
+
 	m_lastSolveTime = m_timer.elapsed() ;
 
 	// compute v
-	v = m_primal->MInv * ( m_primal->H.transpose() * r_loc - m_primal->f ) ;
+	contactForces( r_loc, forces ) ;
+	v = m_primal->MInv * ( forces - m_primal->f ) ;
 
 	r = m_primal->E * r_loc ; // put into world space coord frame
 
@@ -332,20 +917,38 @@ void MecheFrictionProblem::addExternalForce( ExternalForce* force )
     m_primal->m_externalForces.push_back( force );
 }
 
-void MecheFrictionProblem::updateObjectLHS( unsigned oId, Eigen::MatrixXd& M )
+void MecheFrictionProblem::updateObjectLHS( unsigned oId )
 {
-	m_primal->updateObjectLHS( oId, M, ndofOr ) ;
+	// M^-1 of oId refers to its band factorization, which has been updated in place
+	// Other objects' columns are still valid, W and b will be patched by updateDual()
+	if( m_dual )
+	{
+		const std::vector< std::pair< unsigned, unsigned > >& contacts = m_objectContacts[ oId ] ;
+		for( unsigned c = 0 ; c < contacts.size() ; ++c )
+		{
+			computeMInvHt( contacts[c].first, contacts[c].second ) ;
+		}
+	}
+	m_updatedObjects[ oId ] = 1 ;
+}
 
-	//W
-	m_dual->W = m_primal->H * ( m_primal->MInv * m_primal->H.transpose() ) ;
+void MecheFrictionProblem::updateObjectRHS( unsigned oId, const Eigen::VectorXd& f )
+{
+	m_primal->f.segment( m_dofIndices[oId], f.size() ) = f + m_additionalForces.segment( m_dofIndices[oId], f.size() ) ;
+	m_updatedObjects[ oId ] = 1 ;
+}
 
-	// M^-1 f, b
-	m_dual->b = m_primal->E.transpose() * m_primal->w - m_primal->H * ( m_primal->MInv * m_primal->f );
+void MecheFrictionProblem::setAdditionalForces( unsigned oId, const Eigen::VectorXd& forces )
+{
+	m_primal->f.segment( m_dofIndices[oId], forces.size() ) += forces - m_additionalForces.segment( m_dofIndices[oId], forces.size() ) ;
+	m_additionalForces.segment( m_dofIndices[oId], forces.size() ) = forces ;
+	m_updatedObjects[ oId ] = 1 ;
 }
 
-void MecheFrictionProblem::updateObjectRHS( unsigned oId, const Eigen::VectorXd& f )
+void MecheFrictionProblem::updateContactRHS( unsigned cId, const Eigen::Vector3d& w )
 {
-	m_primal->f.segment( m_dofIndices[oId], f.size() ) = f;
+	m_primal->w.segment< 3 >( 3*cId ) = w ;
+	m_updatedContacts[ cId ] = 1 ;
 }
 
 void MecheFrictionProblem::setOutStream( std::ostream *out )
@@ -30,6 +30,7 @@
 #include "../Core/ExternalForce.hh"
 #include "../../hairSim/Utils/Definitions.h"
 #include "../../hairSim/Math/BandMatrixFwd.h"
+#include "../../hairSim/Collision/DeformationGradient.h"
 
 namespace bogus
 {
@@ -45,25 +46,46 @@ public:
 	~MecheFrictionProblem() ;
 
 	//! Allocates and sets up the primal friction problem
-	/*! \warning copies the contents of the matrices M, E and H !
-		Manually constructing a PrimalFrictionProblem would be more efficient
-	*/
+	/*! Convenience wrapper around beginPrimal(), setObject(), setContact() and finalizePrimal() */
 	void fromPrimal (
 		const unsigned int NObj, //!< number of subsystems
-		const std::vector<unsigned> ndof, //!< array of size \a NObj, the number of degree of freedom of each subsystem
-		const std::vector < SymmetricBandMatrixSolver<double, 10>* > MassMat, //!< the square ndof[i]long mass matrix of each subsystem
-		const Eigen::VectorXd  f_in, //!< the constant term in \f$ M v + f= {}^t \! H r \f$
+		const std::vector<unsigned>& ndof, //!< array of size \a NObj, the number of degree of freedom of each subsystem
+		const std::vector < SymmetricBandMatrixSolver<double, 10>* >& MassMat, //!< the square ndof[i]long mass matrix of each subsystem
+		const Eigen::VectorXd& f_in, //!< the constant term in \f$ M v + f= {}^t \! H r \f$
 		const unsigned int n_in, //!< number of contact points
-		const Eigen::VectorXd  mu_in, //!< array of size \a n giving the friction coeffs
-		const std::vector < Eigen::Matrix< double, 3, 3 > > E_in, // E matrix with form: 3*n_in x 3, !< array of size \f$ n \times d \times d \f$ giving the \a n normals followed by the \a n tangent vectors (and by again \a n tangent vectors if \a d is 3). Said otherwise, \a E is a \f$ (nd) \times d \f$ matrix, stored column-major, formed by \a n blocks of size \f$ d \times d \f$ with each block being an orthogonal matrix (the transition matrix from the world space coordinates \f$ (x_1, x_2, x_3) \f$ to the local coordinates \f$ (x_N, x_{T1}, x_{T2}) \f$
-		const Eigen::VectorXd w_in, //!< array of size \a nd, the constant term in \f$ u = H v + w \f$
+		const Eigen::VectorXd& mu_in, //!< array of size \a n giving the friction coeffs
+		const std::vector < Eigen::Matrix< double, 3, 3 > >& E_in, // E matrix with form: 3*n_in x 3, !< array of size \f$ n \times d \times d \f$ giving the \a n normals followed by the \a n tangent vectors (and by again \a n tangent vectors if \a d is 3). Said otherwise, \a E is a \f$ (nd) \times d \f$ matrix, stored column-major, formed by \a n blocks of size \f$ d \times d \f$ with each block being an orthogonal matrix (the transition matrix from the world space coordinates \f$ (x_1, x_2, x_3) \f$ to the local coordinates \f$ (x_N, x_{T1}, x_{T2}) \f$
+		const Eigen::VectorXd& w_in, //!< array of size \a nd, the constant term in \f$ u = H v + w \f$
 		const int * const ObjA, //!< array of size \a n, the first object involved in the \a i-th contact (must be an internal object) (counted from 0)
 		const int * const ObjB, //!< array of size \a n, the second object involved in the \a i-th contact (-1 for an external object) (counted from 0)
-		const std::vector < SparseRowMatx* > HA, //!< array of size \a n, containing pointers to a dense, colum-major matrix of size <c> d*ndof[ObjA[i]] </c> corresponding to the H-matrix of <c> ObjA[i] </c>
-		const std::vector < SparseRowMatx* > HB, //!< array of size \a n, containing pointers to a dense, colum-major matrix of size <c> d*ndof[ObjA[i]] </c> corresponding to the H-matrix of <c> ObjB[i] </c> (\c NULL for an external object)
-		const std::vector < unsigned > dofIndices // map of dofs to rods, indicates where to begin modifying force vector per globalId
+		const std::vector < const DeformationGradient* >& HA, //!< array of size \a n, containing pointers to the deformation gradient of <c> ObjA[i] </c> at the \a i-th contact
+		const std::vector < const DeformationGradient* >& HB, //!< array of size \a n, containing pointers to the deformation gradient of <c> ObjB[i] </c> at the \a i-th contact (\c NULL for an external object)
+		const std::vector < unsigned >& dofIndices // map of dofs to rods, indicates where to begin modifying force vector per globalId
 		 );
 
+	//! Allocates an empty primal problem with the given layout
+	/*! The M, E and H blocks are then written in place by setObject() and setContact(),
+		without going through intermediate arrays. Both may be called concurrently
+		for distinct objects / contacts. finalizePrimal() must be called once everything is set.
+		f, w and mu are zero-initialized.
+	*/
+	void beginPrimal(
+		const std::vector<unsigned>& ndof, //!< the number of degree of freedom of each subsystem
+		const unsigned int n_in, //!< number of contact points
+		const std::vector < unsigned >& dofIndices //!< offset of each subsystem in the global dof vector
+		) ;
+
+	//! Sets the mass matrix and the constant term of subsystem \p oId
+	/*! \p MassMat is referenced, not copied, and must stay factorized until the problem is solved */
+	void setObject( const unsigned oId, const SymmetricBandMatrixSolver<double, 10>& MassMat, const Eigen::VectorXd& f ) ;
+
+	//! Sets the contact \p cId ; \p HB should be NULL when \p ObjB is -1
+	void setContact( const unsigned cId, const double mu, const Eigen::Matrix< double, 3, 3 >& E,
+					 const int ObjA, const int ObjB, const DeformationGradient* HA, const DeformationGradient* HB ) ;
+
+	//! Finalizes the problem set up by beginPrimal()
+	void finalizePrimal() ;
+
 	//! Solves the friction problem ; \sa GaussSeidel
 	double solve(
 		Eigen::VectorXd& r, //!< length \a nd : initialization for \a r (in world space coordinates) + used to return computed r
@@ -78,7 +100,22 @@ public:
 		const unsigned cadouxIters //!< If staticProblem is false and cadouxIters is greater than zero, use the Cadoux algorithm to solve the friction problem.
 				 );
 
+	//! Solves the friction problem without assembling the Delassus operator W
+	/*! Only the diagonal blocks of W are computed, for the local SOC solves ; W r is applied as
+		E^T H M^-1 H^T E r using the objects' band factorizations, so that memory stays linear
+		in the number of contacts. Iterates a projected block Jacobi with adaptive damping.
+		\sa solve()
+	*/
+	double solveMatrixFree(
+		Eigen::VectorXd& r, //!< length \a nd : initialization for \a r (in world space coordinates) + used to return computed r
+		Eigen::VectorXd& v, //!< length \a m: to return computed v
+		const double tol, //!< Jacobi tolerance. 0. means 1.e-6
+		const unsigned maxIters, //!< Max number of Jacobi iterations. 0 means 500
+		const bool useInfinityNorm //!< Whether to use the infinity norm to evaluate the residual of the friction problem
+		) ;
+
 	//! Computes the dual from the primal
+	/*! W and b are evaluated contact by contact from the deformation gradients given to setContact() */
 	void computeDual( double regularization ) ;
 
 	//! Cleams up the problem, then allocates a new PrimalFrictionProblem and make m_primal point to it
@@ -91,10 +128,22 @@ public:
 	void setOutStream( std::ostream *out ) ;
 
 	//! Signal< interationNumber, error, elapsedTime > that will be triggered every few iterations
+	/*! Also triggered at the end of each pass of the outer loop with the external forces, with the pass number */
 	Signal< unsigned, double, double > &callback() { return m_callback ; }
 
 	// solvers Callback
 	void ackCurrentResidual( unsigned GSIter, double err ) ;
+	//! Only triggers the callback, connect to it to log the passes of the outer loop
+	void ackOuterIteration( unsigned pass, double err ) ;
+
+	//! Sets up the outer loop that updates the external forces between inner solves
+	/*! Inner solves start loose and reach the requested tolerance at the last pass ;
+		the loop stops early once the relative change of f is below \p tolerance */
+	void setOuterLoop( unsigned maxIterations, double tolerance )
+	{
+		m_maxOuterIterations = maxIterations ;
+		m_outerTolerance = tolerance ;
+	}
 
 	// Accessors
 
@@ -111,20 +160,71 @@ public:
 	//! Time spent in last solver call. In seconds.
 	double lastSolveTime() const { return m_lastSolveTime ; }
 
+	//! Total number of Gauss-Seidel sweeps performed during the last solver call
+	unsigned lastSolveIterations() const { return m_lastSolveIterations ; }
+
 
 
 	void addExternalForce( ExternalForce *force );
-    void updateObjectLHS ( unsigned oId, Eigen::MatrixXd& M ) ;
+    //! To be called once the band factorization given to setObject() for \p oId has changed
+    /*! Only recomputes the M^-1 H^T columns of the contacts involving \p oId ;
+        the affected blocks of W and b are refreshed by the solver before its next iteration.
+        May be called concurrently for distinct objects. */
+    void updateObjectLHS ( unsigned oId ) ;
     void updateObjectRHS ( unsigned oId, const Eigen::VectorXd &f ) ;
 
+    //! Sets a constant term added to f for \p oId, e.g. the forces of contacts solved in another problem
+    /*! Kept when updateObjectRHS() is called. b is refreshed by the solver, as for updateObjectLHS() */
+    void setAdditionalForces ( unsigned oId, const Eigen::VectorXd &forces ) ;
+    //! Sets the free velocity \p w of contact \p cId, in world coordinates
+    void updateContactRHS ( unsigned cId, const Eigen::Vector3d &w ) ;
+
 protected:
 
+	//! Deformation gradients of both objects at one contact, as given to setContact()
+	struct ContactGradients
+	{
+		int objA ;
+		int objB ;
+		DeformationGradient HA ;
+		DeformationGradient HB ;
+	} ;
+
 	void destroy() ;
 
+	//! Lists the contacts involving each object
+	void computeObjectContacts() ;
+	//! W = H M^-1 H^T, using the structure of the deformation gradients
+	void computeDelassus() ;
+	//! b = E^T w - H M^-1 f
+	void computeDualRhs() ;
+	//! M^-1 H^T for the side \p side of contact \p cId
+	void computeMInvHt( const std::ptrdiff_t cId, const unsigned side ) ;
+	//! W_ij, from the current M^-1 H^T of contact \p j
+	Eigen::Matrix3d delassusBlock( const std::ptrdiff_t i, const std::ptrdiff_t j ) const ;
+	//! b_i, from the current M^-1 f
+	Eigen::Vector3d dualRhs( const std::ptrdiff_t i ) const ;
+	//! Refreshes the blocks of W and b that involve objects or contacts updated since the last call
+	void updateDual() ;
+	//! res = H^T r, with r in local coordinates
+	void contactForces( const Eigen::VectorXd& r, Eigen::VectorXd& res ) const ;
+
+	//! Inner solver tolerance for the outer pass \p pass, \sa setOuterLoop()
+	double innerTolerance( const unsigned pass, const double tol ) const ;
+	static double relativeChange( const Eigen::VectorXd& prev, const Eigen::VectorXd& cur ) ;
+
+	//! W_ii, solving for M^-1 H^T on the fly instead of storing it
+	Eigen::Matrix3d diagonalDelassusBlock( const std::ptrdiff_t i ) const ;
+	//! u = W r + b in local coordinates, evaluated as E^T ( H M^-1 ( H^T E r - f ) + w )
+	void dualVelocities( const Eigen::VectorXd& r, Eigen::VectorXd& u ) const ;
+	//! Damped projected block Jacobi on the matrix-free dual, r in local coordinates
+	double solveJacobi( Eigen::VectorXd& r, const double tol, const unsigned maxIters, const bool useInfinityNorm ) ;
+
 	PrimalFrictionProblem<3u> * m_primal ;
 	DualFrictionProblem<3u>  * m_dual ;
 
 	double m_lastSolveTime ;
+	unsigned m_lastSolveIterations ;
 
 	Signal< unsigned, double, double > m_callback ;
 	Timer m_timer ;
@@ -143,6 +243,28 @@ private:
 
 	std::vector < unsigned > m_dofIndices;
 
+	std::vector < ContactGradients > m_contactGradients ;
+
+	// Kept from computeDual() for incremental updates
+	//! Contacts involving each object, with the side ( 0 for A, 1 for B ) of the object in the contact
+	std::vector < std::vector < std::pair< unsigned, unsigned > > > m_objectContacts ;
+	//! M^-1 H^T for each side of each contact, in world coordinates
+	std::vector < Eigen::MatrixXd > m_MInvHt ;
+	Eigen::VectorXd m_MInvf ;
+	//! Objects whose LHS or RHS changed since the last updateDual()
+	std::vector < char > m_updatedObjects ;
+	//! Contacts whose free velocity changed since the last updateDual()
+	std::vector < char > m_updatedContacts ;
+	//! \sa setAdditionalForces()
+	Eigen::VectorXd m_additionalForces ;
+	//! Diagonal blocks of W, for solveMatrixFree()
+	std::vector < Eigen::Matrix3d > m_diagonalBlocks ;
+	double m_regularization ;
+
+	//! \sa setOuterLoop()
+	unsigned m_maxOuterIterations ;
+	double m_outerTolerance ;
+
 	std::ostream *m_out ;
 } ;
 
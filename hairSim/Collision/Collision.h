@@ -2,12 +2,12 @@
 #define CONTINUOUS_TIME_COLLISION_H_
 
 #include "../Utils/Definitions.h"
+#include "DeformationGradient.h"
 
 class EdgeProxy;
 class FaceProxy;
 class TriMesh;
 class TwistEdgeHandler;
-typedef SparseRowMatx DeformationGradient;
 
 class Collision
 {
@@ -82,7 +82,7 @@ public:
         int globalIndex;
         int vertex; // needed for sorting
         Scalar abscissa;
-        DeformationGradient* defGrad;
+        DeformationGradient defGrad;
         Vec3 worldVel;
     };
 
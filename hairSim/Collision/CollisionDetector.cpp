@@ -4,18 +4,41 @@
 #include "VertexFaceCollision.h"
 #include "EdgeFaceCollision.h"
 #include "EdgeEdgeCollision.h"
-#include "CollisionUtils/SpatialHashMap.hh"
 #include "../Strand/StrandDynamics.h"
+#include "../Utils/Profiler.h"
+#include "../Utils/ThreadPool.h"
 
-Scalar CollisionDetector::s_maxSizeForElementBBox = 1e2;
-CollisionDetector::CollisionDetector( std::vector<ElementProxy*>& elements ):
-        m_elementProxies( elements ), 
+#include <fstream>
+
+CollisionDetector::CollisionDetector( std::vector<ElementProxy*>& elements, bool cacheStaticMeshBVH ):
+        m_elementProxies(), 
         m_bvh(), 
-        m_ignoreStrandStrand( false ), 
-        m_sortedAABBFunctor( NULL ), 
-        m_hashMap( NULL )
+        m_ignoreStrandStrand( false ),
+        m_maxSizeForElementBBox( 1e2 ),
+        m_cacheStaticMeshBVH( cacheStaticMeshBVH ),
+        m_activeStrands( NULL )
 {
     m_proxyHistory = new TwistEdgeHandler();
+
+    // Hair edges go into the per-step tree, mesh faces into one tree per mesh
+    std::map< const TriMeshController*, unsigned > meshIndices;
+    for( auto elem = elements.begin(); elem != elements.end(); ++elem )
+    {
+        FaceProxy* const face = dynamic_cast< FaceProxy* >( *elem );
+        if( !face )
+        {
+            m_elementProxies.push_back( *elem );
+            continue;
+        }
+
+        auto meshIdx = meshIndices.find( face->getController() );
+        if( meshIdx == meshIndices.end() )
+        {
+            meshIdx = meshIndices.insert( std::make_pair( face->getController(), m_meshBVHs.size() ) ).first;
+            m_meshBVHs.push_back( new MeshBVH( face->getController() ) );
+        }
+        m_meshBVHs[ meshIdx->second ]->m_faceProxies.push_back( face );
+    }
 }
 
 CollisionDetector::~CollisionDetector()
@@ -29,48 +52,97 @@ CollisionDetector::~CollisionDetector()
         delete *elem;
     }
 
+    for( auto mesh = m_meshBVHs.begin(); mesh != m_meshBVHs.end(); ++mesh )
+    {
+        for( auto elem = ( *mesh )->m_faceProxies.begin(); elem != ( *mesh )->m_faceProxies.end(); ++elem ){
+            delete *elem;
+        }
+        delete *mesh;
+    }
+
     m_collisions.clear();
-    delete m_sortedAABBFunctor;
-    delete m_hashMap;
     delete m_proxyHistory;
 }
 
 void CollisionDetector::buildBVH( bool statique )
 {
-    Scalar largestElemBBoxSize = 0;
-#pragma omp parallel for
-    for ( unsigned elemId = 0; elemId < m_elementProxies.size() ; ++elemId )
+    PROFILE_SCOPE( "buildBVH" );
+    parallel_for( 0, ( int ) m_elementProxies.size(), [&]( int elemId )
     {
         ElementProxy* elem = m_elementProxies[ elemId ] ;
+        if( !isActive( elem ) )
+        {
+            elem->resetBoundingBox();
+            return;
+        }
 
         elem->updateBoundingBox( statique, m_proxyHistory );
 
         const BBoxType& elemBBox = elem->getBoundingBox();
-        const Scalar elemBBoxSize = elemBBox.maxDim();
 
-        if ( elemBBoxSize > s_maxSizeForElementBBox )
+        if ( elemBBox.maxDim() > m_maxSizeForElementBBox )
         {
             std::cerr << "Element " << *elem << " has large bounding box: "
                 << elemBBox << "; will not be considered for collision detection" << std::endl;
             elem->resetBoundingBox();
         }
+    } );
 
-#pragma omp flush ( largestElemBBoxSize )
-        if( elemBBoxSize > largestElemBBoxSize )
-        {
-#pragma omp critical
-            {
-                if( elemBBoxSize > largestElemBBoxSize ){
-                    largestElemBBoxSize = elemBBoxSize;
-                }
-            }
+    ElementProxyBBoxFunctor bboxfunctor( m_elementProxies );
+    BVHBuilder< ElementProxyBBoxFunctor > bvh_builder;
+    bvh_builder.build( bboxfunctor, &m_bvh );
+
+    for( unsigned m = 0; m < m_meshBVHs.size(); ++m )
+    {
+        buildMeshBVH( *m_meshBVHs[m], statique );
+    }
+}
+
+bool CollisionDetector::isActive( const ElementProxy* elem ) const
+{
+    if( !m_activeStrands ){
+        return true;
+    }
+    const EdgeProxy* const edge = dynamic_cast< const EdgeProxy* >( elem );
+    return !edge || ( *m_activeStrands )[ edge->getStrandPointer()->getGlobalIndex() ];
+}
+
+void CollisionDetector::buildMeshBVH( MeshBVH& mesh, bool statique )
+{
+    const bool isStatic = mesh.m_controller->isStaticMesh();
+
+    if( mesh.m_built )
+    {
+        // Static trees never change; moving meshes keep their topology, so refitting is enough
+        if( !isStatic ){
+            refitBoundingBox( mesh.m_bvh, mesh.m_faceProxies, mesh.m_bvh.GetNode( 0 ), statique );
         }
+        return;
     }
 
-    filterWithSpatialHashMap( largestElemBBoxSize );
-    ElementProxyBBoxFunctor bboxfunctor( m_elementProxies );
+    const std::string cacheFile = mesh.m_controller->getMeshFileName() + ".bvh";
+    const bool useCache = isStatic && m_cacheStaticMeshBVH && !mesh.m_controller->getMeshFileName().empty();
+
+    if( useCache && loadMeshBVH( mesh, cacheFile ) )
+    {
+        refitBoundingBox( mesh.m_bvh, mesh.m_faceProxies, mesh.m_bvh.GetNode( 0 ), statique );
+        mesh.m_built = true;
+        return;
+    }
+
+    parallel_for( 0, ( int ) mesh.m_faceProxies.size(), [&]( int elemId )
+    {
+        mesh.m_faceProxies[ elemId ]->updateBoundingBox( statique );
+    } );
+
+    ElementProxyBBoxFunctor bboxfunctor( mesh.m_faceProxies );
     BVHBuilder< ElementProxyBBoxFunctor > bvh_builder;
-    bvh_builder.build( bboxfunctor, &m_bvh );
+    bvh_builder.build( bboxfunctor, &mesh.m_bvh );
+    mesh.m_built = true;
+
+    if( useCache ){
+        saveMeshBVH( mesh, cacheFile );
+    }
 }
 
 void CollisionDetector::updateBoundingBoxes()
@@ -79,6 +151,11 @@ void CollisionDetector::updateBoundingBoxes()
 }
 
 void CollisionDetector::updateBoundingBox( BVHNodeType& node )
+{
+    refitBoundingBox( m_bvh, m_elementProxies, node, false );
+}
+
+void CollisionDetector::refitBoundingBox( BVH& bvh, std::vector< ElementProxy* >& proxies, BVHNodeType& node, bool statique )
 {
     BVHNodeType::BBoxType& bbox = node.BBox();
     bbox.reset();
@@ -88,17 +165,22 @@ void CollisionDetector::updateBoundingBox( BVHNodeType& node )
         const uint32_t leaf_end = node.LeafEnd();
         for ( uint32_t i = leaf_begin; i < leaf_end; ++i )
         {
-            m_elementProxies[i]->updateBoundingBox( false );
-            const BBoxType& elemBBox = m_elementProxies[i]->getBoundingBox();
+            if( !isActive( proxies[i] ) )
+            {
+                proxies[i]->resetBoundingBox();
+                continue;
+            }
+            proxies[i]->updateBoundingBox( statique );
+            const BBoxType& elemBBox = proxies[i]->getBoundingBox();
 
-            if ( elemBBox.maxDim() <= s_maxSizeForElementBBox )
+            if ( elemBBox.maxDim() <= m_maxSizeForElementBBox )
             {
                 bbox.insert( elemBBox );
             }
             else
             {
-                m_elementProxies[i]->resetBoundingBox();
-                std::cerr << "Element " << *m_elementProxies[i]
+                proxies[i]->resetBoundingBox();
+                std::cerr << "Element " << *proxies[i]
                     << " has large bounding box: " << elemBBox
                     << "; will not be considered for collision detection" << std::endl;
             }
@@ -106,21 +188,163 @@ void CollisionDetector::updateBoundingBox( BVHNodeType& node )
     }
     else // Update the children, then this node's bounding box
     {
-        BVHNodeType& hansel = m_bvh.GetNode( node.ChildIndex() );
-        updateBoundingBox( hansel );
+        BVHNodeType& hansel = bvh.GetNode( node.ChildIndex() );
+        refitBoundingBox( bvh, proxies, hansel, statique );
         bbox.insert( hansel.BBox() );
-        BVHNodeType& gretel = m_bvh.GetNode( node.ChildIndex() + 1 );
-        updateBoundingBox( gretel );
+        BVHNodeType& gretel = bvh.GetNode( node.ChildIndex() + 1 );
+        refitBoundingBox( bvh, proxies, gretel, statique );
         bbox.insert( gretel.BBox() );
     }
 }
 
+// Cache layout: face count, node count, face order of the leaves, then ( index, end ) per node.
+// Bounding boxes are not stored; they are refitted from the current geometry after loading.
+bool CollisionDetector::loadMeshBVH( MeshBVH& mesh, const std::string& fileName )
+{
+    std::ifstream in( fileName.c_str(), std::ios::binary );
+    if( !in.is_open() ){
+        return false;
+    }
+
+    uint32_t numFaces, numNodes;
+    in.read( (char*) &numFaces, sizeof( numFaces ) );
+    in.read( (char*) &numNodes, sizeof( numNodes ) );
+    if( !in || numFaces != mesh.m_faceProxies.size() || numNodes == 0 || numNodes > 2 * numFaces + 1 ){
+        std::cerr << "Ignoring stale BVH cache " << fileName << std::endl;
+        return false;
+    }
+
+    std::vector< uint32_t > faceOrder( numFaces );
+    std::vector< uint32_t > nodeIndices( 2 * numNodes );
+    if( numFaces ){
+        in.read( (char*) &faceOrder[0], numFaces * sizeof( uint32_t ) );
+    }
+    in.read( (char*) &nodeIndices[0], 2 * numNodes * sizeof( uint32_t ) );
+    if( !in ){
+        std::cerr << "Ignoring truncated BVH cache " << fileName << std::endl;
+        return false;
+    }
+
+    std::vector< ElementProxy* > byIndex( numFaces, NULL );
+    for( unsigned f = 0; f < numFaces; ++f )
+    {
+        FaceProxy* const face = static_cast< FaceProxy* >( mesh.m_faceProxies[f] );
+        if( face->getFaceIndex() >= numFaces ){
+            return false;
+        }
+        byIndex[ face->getFaceIndex() ] = face;
+    }
+
+    std::vector< ElementProxy* > ordered( numFaces );
+    for( unsigned f = 0; f < numFaces; ++f )
+    {
+        if( faceOrder[f] >= numFaces || !byIndex[ faceOrder[f] ] ){
+            std::cerr << "Ignoring corrupted BVH cache " << fileName << std::endl;
+            return false;
+        }
+        ordered[f] = byIndex[ faceOrder[f] ];
+        byIndex[ faceOrder[f] ] = NULL;
+    }
+    mesh.m_faceProxies.swap( ordered );
+
+    std::vector< BVHNodeType >& nodes = mesh.m_bvh.GetNodeVector();
+    nodes.resize( numNodes );
+    for( unsigned n = 0; n < numNodes; ++n )
+    {
+        nodes[n].m_index = nodeIndices[ 2 * n ];
+        nodes[n].m_end = nodeIndices[ 2 * n + 1 ];
+
+        const bool valid = nodes[n].IsLeaf()
+                ? nodes[n].LeafBegin() <= nodes[n].LeafEnd() && nodes[n].LeafEnd() <= numFaces
+                : nodes[n].ChildIndex() > n && nodes[n].ChildIndex() + 1 < numNodes;
+        if( !valid ){
+            std::cerr << "Ignoring corrupted BVH cache " << fileName << std::endl;
+            nodes.clear();
+            return false;
+        }
+    }
+
+    std::cout << "# Loaded mesh BVH: " << fileName << std::endl;
+    return true;
+}
+
+void CollisionDetector::saveMeshBVH( const MeshBVH& mesh, const std::string& fileName ) const
+{
+    std::ofstream out( fileName.c_str(), std::ios::binary );
+    if( !out.is_open() ){
+        std::cerr << "Could not write BVH cache " << fileName << std::endl;
+        return;
+    }
+
+    const std::vector< BVHNodeType >& nodes = mesh.m_bvh.GetNodeVector();
+    const uint32_t numFaces = mesh.m_faceProxies.size();
+    const uint32_t numNodes = nodes.size();
+    out.write( (const char*) &numFaces, sizeof( numFaces ) );
+    out.write( (const char*) &numNodes, sizeof( numNodes ) );
+
+    for( unsigned f = 0; f < numFaces; ++f )
+    {
+        const uint32_t faceIndex = static_cast< const FaceProxy* >( mesh.m_faceProxies[f] )->getFaceIndex();
+        out.write( (const char*) &faceIndex, sizeof( faceIndex ) );
+    }
+    for( unsigned n = 0; n < numNodes; ++n )
+    {
+        out.write( (const char*) &nodes[n].m_index, sizeof( uint32_t ) );
+        out.write( (const char*) &nodes[n].m_end, sizeof( uint32_t ) );
+    }
+}
+
 void CollisionDetector::findCollisions( bool ignoreStrandStrand )
 {
+    PROFILE_SCOPE( "findCollisions" );
     assert( empty() );
 
     m_ignoreStrandStrand = ignoreStrandStrand;
 
+    if( !m_ignoreStrandStrand ){
+        findStrandStrandCollisions();
+    }
+    findMeshCollisions();
+}
+
+void CollisionDetector::findMeshCollisions()
+{
+    if( m_meshBVHs.empty() || m_bvh.GetNodeVector().empty() ){
+        return;
+    }
+
+    // Split the hair tree into up to 8 subtrees, and traverse each of them against each mesh tree
+    std::vector< const BVHNodeType* > hairNodes( 1, &m_bvh.GetNode( 0 ) );
+    for( unsigned depth = 0; depth < 3; ++depth )
+    {
+        std::vector< const BVHNodeType* > children;
+        for( unsigned n = 0; n < hairNodes.size(); ++n )
+        {
+            if( hairNodes[n]->IsLeaf() ){
+                children.push_back( hairNodes[n] );
+            }
+            else{
+                children.push_back( &m_bvh.GetNode( hairNodes[n]->ChildIndex() ) );
+                children.push_back( &m_bvh.GetNode( hairNodes[n]->ChildIndex() + 1 ) );
+            }
+        }
+        hairNodes.swap( children );
+    }
+
+    const unsigned numHairNodes = hairNodes.size();
+    const unsigned numTasks = numHairNodes * m_meshBVHs.size();
+    parallel_for( 0, ( int ) numTasks, [&]( int t )
+    {
+        const MeshBVH& mesh = *m_meshBVHs[ t / numHairNodes ];
+        // Meshes with a level set are handled by Simulation::gatherLevelSetCollisions
+        if( !mesh.m_bvh.GetNodeVector().empty() && !mesh.m_controller->hasLevelSet() ){
+            computeMeshCollisions( *hairNodes[ t % numHairNodes ], mesh, mesh.m_bvh.GetNode( 0 ) );
+        }
+    }, 1 );
+}
+
+void CollisionDetector::findStrandStrandCollisions()
+{
     const BVHNodeType& root = m_bvh.GetNode( 0 );
 
     if ( root.IsLeaf() ) // Can't really call this a tree, can we?
@@ -412,7 +636,7 @@ bool CollisionDetector::appendCollision( EdgeProxy* edge_a, EdgeProxy* edge_b )
                 TwistEdge* twist_a = dynamic_cast< TwistEdge* >( collision->getFirstEdgeProxy() );
                 TwistEdge* twist_b = dynamic_cast< TwistEdge* >( collision->getSecondEdgeProxy() );
 
-                TwistEdge* twistBand = new TwistEdge( twist_a, twist_b );
+                TwistEdge* twistBand = new TwistEdge( twist_a, twist_b, m_proxyHistory->m_edgeCounter++ );
 
                 // std::cout << "CollisionDetector new twistBand is " << twistBand->uniqueID << std::endl;
                 m_proxyHistory->tunnelingBands.push_back( twistBand );
@@ -530,37 +754,34 @@ void CollisionDetector::computeCollisions( const BVHNodeType& node_a, const BVHN
     }
 }
 
-void CollisionDetector::filterWithSpatialHashMap( const Scalar largestBBox )
+void CollisionDetector::computeMeshCollisions( const BVHNodeType& node_a, const MeshBVH& mesh, const BVHNodeType& node_b )
 {
-    if ( !m_sortedAABBFunctor )
-    {
-        m_sortedAABBFunctor = new ElementProxySortedAABBFunctor( m_elementProxies );
-    }
-    if ( !m_hashMap )
-    {
-        m_hashMap = new SpatialHashMapT();
+    if ( !intersect( node_a.BBox(), node_b.BBox() ) ){
+        return;
     }
 
-    m_hashMap->setCellSize( std::max( 1., .5 * largestBBox ) );
-
-    const ElementProxySortedAABBFunctor& func( *m_sortedAABBFunctor );
-
-    const unsigned numEdgeProxies = func.numEdgeProxies();
-
-    m_hashMap->addToFootPrint( func, 0, numEdgeProxies );
-
-#pragma omp parallel for
-    for ( unsigned k = numEdgeProxies; k < m_elementProxies.size(); ++k )
+    if ( node_a.IsLeaf() && node_b.IsLeaf() )
     {
-        if ( !m_hashMap->isInFootPrint( func, k, k + 1 ) )
+        for ( unsigned int i = node_a.LeafBegin(); i < node_a.LeafEnd(); ++i )
         {
-            func.elementProxy( k )->resetBoundingBox();
+            EdgeProxy* const edge = dynamic_cast< EdgeProxy* >( m_elementProxies[i] );
+            if( !edge ) continue;
+
+            for ( unsigned int j = node_b.LeafBegin(); j < node_b.LeafEnd(); ++j )
+            {
+                appendCollision( edge, static_cast< const FaceProxy* >( mesh.m_faceProxies[j] ) );
+            }
         }
     }
-
-    m_hashMap->clear() ;
-    delete m_hashMap;
-    delete m_sortedAABBFunctor;
-    m_sortedAABBFunctor = NULL;
-    m_hashMap = NULL;
+    // Descend into the larger volume first, so that both trees are refined at the same pace
+    else if ( node_b.IsLeaf() || ( !node_a.IsLeaf() && node_a.BBox().maxDim() > node_b.BBox().maxDim() ) )
+    {
+        computeMeshCollisions( m_bvh.GetNode( node_a.ChildIndex() ), mesh, node_b );
+        computeMeshCollisions( m_bvh.GetNode( node_a.ChildIndex() + 1 ), mesh, node_b );
+    }
+    else
+    {
+        computeMeshCollisions( node_a, mesh, mesh.m_bvh.GetNode( node_b.ChildIndex() ) );
+        computeMeshCollisions( node_a, mesh, mesh.m_bvh.GetNode( node_b.ChildIndex() + 1 ) );
+    }
 }
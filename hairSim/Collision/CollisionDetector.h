@@ -7,19 +7,18 @@
 
 #include "CollisionUtils/BVH.hh"
 
-#include "CollisionUtils/SpatialHashMapFwd.hh"
 #include "TwistEdgeHandler.h"
 
 class ElementProxy;
 class EdgeProxy;
 class FaceProxy;
 class Collision;
-class ElementProxySortedAABBFunctor;
+class TriMeshController;
 
 class CollisionDetector
 {
 public:
-    CollisionDetector( std::vector< ElementProxy* >& elements );
+    CollisionDetector( std::vector< ElementProxy* >& elements, bool cacheStaticMeshBVH = false );
     virtual ~CollisionDetector();
 
     void buildBVH( bool statique = false );
@@ -37,28 +36,62 @@ public:
     std::list< Collision* >& getCollisions()
     { return m_collisions; }
 
-    static void setMaxSizeForElementBBox( double s )
-    { s_maxSizeForElementBBox = s; }
+    void setMaxSizeForElementBBox( double s )
+    { m_maxSizeForElementBBox = s; }
+
+    //! If true, static mesh trees are read from/written to "<obj file>.bvh"
+    void setCacheStaticMeshBVH( bool cache )
+    { m_cacheStaticMeshBVH = cache; }
+
+    //! Edges of the strands whose flag is zero are left out of the tree, NULL to keep all of them
+    /*! \p active is indexed by strand global index, and must outlive its use */
+    void setActiveStrands( const std::vector< char >* active )
+    { m_activeStrands = active; }
 
     TwistEdgeHandler* m_proxyHistory;
     std::vector<ElementProxy*> m_elementProxies;
 
 protected:
 
+    //! Face tree of one mesh; built once for static meshes, refitted every step otherwise
+    struct MeshBVH
+    {
+        MeshBVH( TriMeshController* controller ):
+            m_controller( controller ),
+            m_built( false )
+        {}
+
+        TriMeshController* m_controller;
+        std::vector< ElementProxy* > m_faceProxies;
+        BVH m_bvh;
+        bool m_built;
+    };
+
+    void buildMeshBVH( MeshBVH& mesh, bool statique );
+    void refitBoundingBox( BVH& bvh, std::vector< ElementProxy* >& proxies, BVHNodeType& node, bool statique );
+    bool loadMeshBVH( MeshBVH& mesh, const std::string& fileName );
+    void saveMeshBVH( const MeshBVH& mesh, const std::string& fileName ) const;
+
+    void findStrandStrandCollisions();
+    void findMeshCollisions();
+
     void computeCollisions( const BVHNodeType& node_a, const BVHNodeType& node_b );
+    void computeMeshCollisions( const BVHNodeType& node_a, const MeshBVH& mesh, const BVHNodeType& node_b );
     bool appendCollision( ElementProxy* elem_a, ElementProxy* elem_b );
     bool appendCollision( EdgeProxy* edge_a, EdgeProxy* edge_b );
     bool appendCollision( EdgeProxy* edge_a, const FaceProxy* triangle_b );
-    void filterWithSpatialHashMap( const Scalar largestBBox );
 
-    BVH m_bvh;
+    BVH m_bvh; //!< Hair edges (and tunneling bands) only
+    std::vector< MeshBVH* > m_meshBVHs;
     std::list< Collision* > m_collisions;
     bool m_ignoreStrandStrand;
 
-    static Scalar s_maxSizeForElementBBox;
-    ElementProxySortedAABBFunctor* m_sortedAABBFunctor;
-    typedef SpatialHashMap<const ElementProxySortedAABBFunctor, unsigned, true> SpatialHashMapT;
-    SpatialHashMapT* m_hashMap;
+    //! Whether \p elem is not an edge of a strand left out by setActiveStrands()
+    bool isActive( const ElementProxy* elem ) const;
+
+    Scalar m_maxSizeForElementBBox;
+    bool m_cacheStaticMeshBVH;
+    const std::vector< char >* m_activeStrands;
 
 };
 
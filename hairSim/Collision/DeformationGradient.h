@@ -0,0 +1,81 @@
+#ifndef DEFORMATIONGRADIENT_H_
+#define DEFORMATIONGRADIENT_H_
+
+#include "../Utils/Definitions.h"
+
+/* [H]
+    Jacobian of a contact point wrt. the degrees of freedom of its strand.
+    The point lies at 'abscissa' along the edge starting at 'vertex', so the only
+    non-zeros are ( 1 - abscissa ) on the x,y,z dofs of vertex and abscissa on
+    those of vertex + 1 -- a 3 x 8 window starting at column 4 * vertex, whose
+    twist columns are zero.
+    Products below only touch that window instead of going through a sparse index.
+*/
+
+class DeformationGradient
+{
+public:
+    static const int WindowCols = 8;
+
+    DeformationGradient():
+        m_vertex( 0 ),
+        m_abscissa( 0. ),
+        m_cols( 0 )
+    {}
+
+    DeformationGradient( int vertex, Scalar abscissa, unsigned cols ):
+        m_vertex( vertex ),
+        m_abscissa( abscissa ),
+        m_cols( cols )
+    {}
+
+    int vertex() const
+    { return m_vertex; }
+
+    Scalar abscissa() const
+    { return m_abscissa; }
+
+    //! Number of dofs of the strand
+    unsigned cols() const
+    { return m_cols; }
+
+    unsigned firstCol() const
+    { return 4 * m_vertex; }
+
+    //! H x, for x a vector or a ( cols() x k ) matrix
+    template< typename Derived >
+    Eigen::Matrix< Scalar, 3, Derived::ColsAtCompileTime > multiply( const Eigen::MatrixBase< Derived >& x ) const
+    {
+        Eigen::Matrix< Scalar, 3, Derived::ColsAtCompileTime > Hx = ( 1. - m_abscissa ) * x.template middleRows<3>( firstCol() );
+        if( m_abscissa > 0. ){
+            Hx += m_abscissa * x.template middleRows<3>( firstCol() + 4 );
+        }
+        return Hx;
+    }
+
+    //! f += H^T r, where the dofs of the strand start at offset in f
+    void addTransposeMultiply( const Vec3& r, VecXx& f, unsigned offset = 0 ) const
+    {
+        f.segment<3>( offset + firstCol() ) += ( 1. - m_abscissa ) * r;
+        if( m_abscissa > 0. ){
+            f.segment<3>( offset + firstCol() + 4 ) += m_abscissa * r;
+        }
+    }
+
+    //! Dense ( cols() x 3 ) H^T, eg. to be solved against a mass matrix
+    void transposeTo( MatXx& Ht ) const
+    {
+        Ht.setZero( m_cols, 3 );
+        Ht.middleRows<3>( firstCol() ).diagonal().setConstant( 1. - m_abscissa );
+        if( m_abscissa > 0. ){
+            Ht.middleRows<3>( firstCol() + 4 ).diagonal().setConstant( m_abscissa );
+        }
+    }
+
+private:
+    int m_vertex;
+    Scalar m_abscissa;
+    unsigned m_cols;
+};
+
+#endif /* DEFORMATIONGRADIENT_H_ */
@@ -79,8 +79,7 @@ void TwistEdge::computeBoundingBox( BBoxType& boundingBox, bool statique, TwistE
     boundingBox.insert( max );
 }
 
-int edgeCounter = 0;
-TwistEdge::TwistEdge( ElasticStrand& strand, int vertexIndex ):
+TwistEdge::TwistEdge( ElasticStrand& strand, int vertexIndex, int uID ):
     CylinderProxy( strand, vertexIndex ),
     isTwistedBand( false ), 
     flagged( false ),
@@ -88,36 +87,12 @@ TwistEdge::TwistEdge( ElasticStrand& strand, int vertexIndex ):
     prev( NULL ),
     next( NULL )
 {
-    uniqueID = edgeCounter++;
+    uniqueID = uID;
     parents.first = NULL;
     parents.second = NULL;
 }
 
-TwistEdge::TwistEdge( TwistEdge* first, TwistEdge* second ):
-    CylinderProxy( first->m_strand, first->m_vertexIndex ),
-    isTwistedBand( true ),
-    flagged( false ),
-    traversed( false ),
-    prev( NULL ),
-    next( NULL )
-{
-    TwistEdge* alpha = first;
-    TwistEdge* beta = second;
-
-    uniqueID = edgeCounter++;
-
-    // std::cout << "Creating tunneling from first: " << first->uniqueID << " second: " << second->uniqueID << " with edgeCounter: " << edgeCounter << " my uniqueID: " << uniqueID << std::endl;
-
-    parents.first = alpha;
-    parents.second = beta;
-
-    // intersections.push( new TwistIntersection( angleAtTimeOfCollision ) );
-
-    alpha->children.push_back( std::pair< int, TwistEdge* >( beta->uniqueID, this ) );
-    beta->children.push_back( std::pair< int, TwistEdge* >( alpha->uniqueID, this ) );
-}
-
-TwistEdge::TwistEdge( TwistEdge* first, TwistEdge* second, int& uID ):
+TwistEdge::TwistEdge( TwistEdge* first, TwistEdge* second, int uID ):
     CylinderProxy( first->m_strand, first->m_vertexIndex ),
     isTwistedBand( true ),
     flagged( false ),
@@ -148,9 +148,9 @@ struct TwistIntersection
 class TwistEdge: public CylinderProxy
 {
 public:
-    TwistEdge( ElasticStrand& strand, int vertexIndex );
-    TwistEdge( TwistEdge* first, TwistEdge* second );
-    TwistEdge( TwistEdge* first, TwistEdge* second, int& uID );
+    //! \p uID is unique among the edges and bands of a simulation, see TwistEdgeHandler::m_edgeCounter
+    TwistEdge( ElasticStrand& strand, int vertexIndex, int uID );
+    TwistEdge( TwistEdge* first, TwistEdge* second, int uID );
 
     Scalar currAngle() const;
     int coplanarTwists() const;
@@ -277,6 +277,16 @@ public:
         return m_controller->getMesh();
     }
 
+    TriMeshController* getController() const
+    {
+        return m_controller;
+    }
+
+    unsigned getFaceIndex() const
+    {
+        return m_faceIndex;
+    }
+
     Vec3 getNormal() const
     {
         const Vec3 &q0 = getVertex( 0 );
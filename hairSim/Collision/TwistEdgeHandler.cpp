@@ -5,6 +5,7 @@
 #include "../Strand/StrandDynamics.h"
 #include "../Math/Distances.hh"
 #include "CollisionUtils/CollisionUtils.h"
+#include "../Utils/Profiler.h"
 
 #define CROSS_RESULT_EPSILON 1e-16
 #define FRACTIONAL_INFLUENCE_MULTIPLIER 0.25
@@ -16,7 +17,9 @@ using namespace std;
 
 TwistEdgeHandler::TwistEdgeHandler(): 
     m_frozenCheck(0), 
-    m_frozenScene(false)
+    m_frozenScene(false),
+    m_edgeCounter(0),
+    m_crossingCount(0)
 {}
 
 TwistEdgeHandler::~TwistEdgeHandler()
@@ -80,9 +83,9 @@ bool signPos( double number )
 {
     return number > 1e-17; // tweak this..
 }
-static int crossingCount = 0;
 void TwistEdgeHandler::updateTwistAngle( TwistEdge* edge, TwistEdge* startPA, TwistEdge* startPB, TwistEdge* endPA, TwistEdge* endPB, const bool& traversal )
 {
+    PROFILE_SCOPE( "twist angle" );
     Vec3 edgeA, edgeB;
     getEdgeVerts( edge, true, edgeA, edgeB );
     Vec3 planeNormal = edgeB - edgeA;
@@ -138,7 +141,7 @@ void TwistEdgeHandler::updateTwistAngle( TwistEdge* edge, TwistEdge* startPA, Tw
                 edge->intersections.push( new TwistIntersection( finalAngle ) );
                 edge->intersections.top()->originalTwistAngle = finalAngle;
                 edge->intersections.top()->currAngle = finalAngle;
-                std::cout << "crossing " << ++crossingCount << std::endl;
+                std::cout << "crossing " << ++m_crossingCount << std::endl;
                 return;
             }
         }
@@ -220,6 +223,7 @@ void TwistEdgeHandler::deleteBand( TwistEdge* edge, std::vector< ElementProxy* >
 
 void TwistEdgeHandler::applyImpulses( ElasticStrand* strand, ImplicitStepper* stepper, bool computeImpulses )
 {
+    PROFILE_SCOPE( "band impulses" );
     bool impulsesON = true;
     if( !impulsesON || !computeImpulses ){
         return;
@@ -26,6 +26,8 @@ public:
 
     int m_frozenCheck;
     bool m_frozenScene;
+    int m_edgeCounter; // next uniqueID of a TwistEdge
+    int m_crossingCount;
     bool trackTunneling;
     bool repeatCD;
 };
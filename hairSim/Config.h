@@ -20,9 +20,5 @@ const double abscissaReplacementTolerance = 0.0; //1.4; // 1.4 ?
 const bool rejectSelfCollisions = true;
 
 static bool nonLinearCallbackBogus = false;
-static bool hLoop = false;
-static bool trackGeometricRelations = true;
-static bool penaltyOnce = true;
-static bool penaltyAfter = true;
 
 #endif
@@ -22,21 +22,21 @@ GravitationForce::~GravitationForce()
 Scalar GravitationForce::localEnergy( const ElasticStrand& strand, const StrandState& geometry,
         const IndexType vtx )
 {
-    return -strand.m_vertexMasses[vtx] * geometry.getVertex( vtx ).dot( s_gravity );
+    return -strand.m_vertexMasses[vtx] * geometry.getVertex( vtx ).dot( strand.m_gravity );
 }
 
 template<>
 void GravitationForce::computeLocal<Scalar>( Scalar& localE, const ElasticStrand& strand,
         const StrandState& geometry, const IndexType vtx )
 {
-    localE = -strand.m_vertexMasses[vtx] * geometry.getVertex( vtx ).dot( s_gravity );
+    localE = -strand.m_vertexMasses[vtx] * geometry.getVertex( vtx ).dot( strand.m_gravity );
 }
 
 template<>
 void GravitationForce::computeLocal<Vec3>( Vec3& localF, const ElasticStrand& strand,
         const StrandState& geometry, const IndexType vtx )
 {
-    localF = strand.m_vertexMasses[vtx] * s_gravity;
+    localF = strand.m_vertexMasses[vtx] * strand.m_gravity;
 }
 
 template<>
@@ -59,5 +59,3 @@ void GravitationForce::addInPosition<JacobianMatrixType, Mat3x>( JacobianMatrixT
 {
     globalJacobian.localStencilAdd<3>( 4 * vtx, localJacobian );
 }
-
-Vec3 GravitationForce::s_gravity( 0.0, -981.0, 0.0 ); // Acceleration vector, in cm/s^2 to match Maya's units. Also, the y-axis is vertical.
@@ -38,14 +38,6 @@ public:
 
     template<typename GlobalT, typename LocalT>
     static void addInPosition( GlobalT& global, const IndexType vtx, const LocalT& local );
-
-    static void setGravity( const Vec3& gravity )
-    {
-        s_gravity = gravity;
-    }
-
-private:
-    static Vec3 s_gravity;
 };
 
 #endif /* GRAVITATIONFORCE_HH_ */
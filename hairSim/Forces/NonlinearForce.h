@@ -30,18 +30,10 @@ public:
         bool needsUpdate = m_stepper.updateLinearSystem( solverForces );
         if( needsUpdate )
         { // if update occured, need to inform Bogus/problem solver of new system
-            JacobianSolver *M = &m_stepper.linearSolver();
-
+            // the problem solves with m_stepper.linearSolver(), which has been refactored in place
             std::cout << "updating linear system " << m_stepper.m_strand.getGlobalIndex() <<  std::endl;
 
-            Eigen::MatrixXd MecheM( M->matrix().rows(), M->matrix().cols() );
-            for( int r = 0; r < MecheM.rows(); ++r ){
-                for( int c= 0; c < MecheM.cols(); ++c ){
-                    MecheM(r,c) = M->matrix()(r,c);
-                }
-            }
-
-            m_problem.updateObjectLHS( m_objectID, MecheM );
+            m_problem.updateObjectLHS( m_objectID );
             m_problem.updateObjectRHS( m_objectID, -m_stepper.rhs() );
         }
         return needsUpdate;
@@ -0,0 +1,221 @@
+#include "LevelSet.h"
+#include "TriMesh.h"
+#include "../Math/Distances.hh"
+
+#include <cmath>
+
+LevelSet::LevelSet():
+    m_cellSize( 1. ),
+    m_bandWidth( 0. ),
+    m_origin( Vec3::Zero() ),
+    m_rotation( Mat3x::Identity() ),
+    m_translation( Vec3::Zero() ),
+    m_lastRotation( Mat3x::Identity() ),
+    m_lastCenter( Vec3::Zero() ),
+    m_lastTranslate( Vec3::Zero() )
+{}
+
+void LevelSet::build( const TriMesh& mesh, Scalar cellSize, Scalar bandWidth )
+{
+    m_cellSize = cellSize;
+    m_bandWidth = bandWidth;
+    m_rotation.setIdentity();
+    m_translation.setZero();
+    m_lastRotation.setIdentity();
+    m_lastCenter.setZero();
+    m_lastTranslate.setZero();
+    m_blocks.clear();
+
+    if( !mesh.nv() || !mesh.nf() ){
+        return;
+    }
+
+    Vec3 minCorner = mesh.getVertex( 0 );
+    for( unsigned v = 1; v < mesh.nv(); ++v ){
+        minCorner = minCorner.cwiseMin( mesh.getVertex( v ) );
+    }
+    m_origin = minCorner - Vec3::Constant( bandWidth + cellSize );
+
+    // Bucket faces by the blocks their band-inflated bounding box overlaps
+    const int B = BLOCK_SIZE;
+    std::unordered_map< int64_t, std::vector< unsigned > > blockFaces;
+    std::vector< Vec3i > blockCoords;
+    for( unsigned f = 0; f < mesh.nf(); ++f )
+    {
+        const TriangularFace& face = mesh.getFace( f );
+        const Vec3& a = mesh.getVertex( face.idx[0] );
+        const Vec3& b = mesh.getVertex( face.idx[1] );
+        const Vec3& c = mesh.getVertex( face.idx[2] );
+
+        const Vec3 fmin = ( a.cwiseMin( b ).cwiseMin( c ) - Vec3::Constant( bandWidth ) - m_origin ) / cellSize;
+        const Vec3 fmax = ( a.cwiseMax( b ).cwiseMax( c ) + Vec3::Constant( bandWidth ) - m_origin ) / cellSize;
+
+        Vec3i bmin, bmax;
+        for( short k = 0; k < 3; ++k )
+        {
+            bmin[k] = floorDiv( ( int ) std::floor( fmin[k] ), B );
+            bmax[k] = floorDiv( ( int ) std::ceil( fmax[k] ), B );
+        }
+
+        for( int bi = bmin[0]; bi <= bmax[0]; ++bi )
+            for( int bj = bmin[1]; bj <= bmax[1]; ++bj )
+                for( int bk = bmin[2]; bk <= bmax[2]; ++bk )
+                {
+                    std::vector< unsigned >& faces = blockFaces[ blockKey( bi, bj, bk ) ];
+                    if( faces.empty() ){
+                        blockCoords.push_back( Vec3i( bi, bj, bk ) );
+                    }
+                    faces.push_back( f );
+                }
+    }
+
+    for( unsigned b = 0; b < blockCoords.size(); ++b ){
+        m_blocks[ blockKey( blockCoords[b][0], blockCoords[b][1], blockCoords[b][2] ) ];
+    }
+
+    // Blocks are independent, fill them in parallel
+#pragma omp parallel for schedule( dynamic, 4 )
+    for( int b = 0; b < ( int ) blockCoords.size(); ++b )
+    {
+        const Vec3i& bc = blockCoords[b];
+        const int64_t key = blockKey( bc[0], bc[1], bc[2] );
+        const std::vector< unsigned >& faces = blockFaces.find( key )->second;
+        Block& block = m_blocks.find( key )->second;
+
+        for( int v = 0; v < B * B * B; ++v )
+        {
+            const int i = bc[0] * B + v / ( B * B );
+            const int j = bc[1] * B + ( v / B ) % B;
+            const int k = bc[2] * B + v % B;
+            const Vec3 p = m_origin + cellSize * Vec3( ( Scalar ) i, ( Scalar ) j, ( Scalar ) k );
+
+            Scalar bestDist = bandWidth;
+            Scalar bestCos = 0.;
+            Scalar sign = 1.;
+            for( unsigned n = 0; n < faces.size(); ++n )
+            {
+                const TriangularFace& face = mesh.getFace( faces[n] );
+                const Vec3& q0 = mesh.getVertex( face.idx[0] );
+                const Vec3& q1 = mesh.getVertex( face.idx[1] );
+                const Vec3& q2 = mesh.getVertex( face.idx[2] );
+
+                const Vec3 diff = p - ClosestPtPointTriangle( p, q0, q1, q2 );
+                const Scalar dist = diff.norm();
+                if( dist > bestDist + 1e-6 * cellSize ){
+                    continue;
+                }
+
+                // Closest points on shared edges/vertices are ambiguous;
+                // keep the face whose normal is most aligned with p - closest point
+                const Vec3 normal = ( q1 - q0 ).cross( q2 - q0 ).normalized();
+                const Scalar cosine = isSmall( dist ) ? 1. : normal.dot( diff ) / dist;
+                if( dist < bestDist - 1e-6 * cellSize || std::fabs( cosine ) > bestCos )
+                {
+                    bestDist = dist;
+                    bestCos = std::fabs( cosine );
+                    sign = cosine < 0. ? -1. : 1.;
+                }
+            }
+            block.phi[v] = ( float )( sign * bestDist );
+        }
+    }
+
+    std::cout << "# Built level set: " << m_blocks.size() << " blocks of " << B << "^3 voxels" << std::endl;
+}
+
+void LevelSet::applyRigidTransform( const Mat3x& rotation, const Vec3& center, const Vec3& translate )
+{
+    m_translation = rotation * ( m_translation - center ) + center + translate;
+    m_rotation = rotation * m_rotation;
+
+    m_lastRotation = rotation;
+    m_lastCenter = center;
+    m_lastTranslate = translate;
+}
+
+float LevelSet::nodeValue( int i, int j, int k ) const
+{
+    const int B = BLOCK_SIZE;
+    const int bi = floorDiv( i, B ), bj = floorDiv( j, B ), bk = floorDiv( k, B );
+
+    const Blocks::const_iterator block = m_blocks.find( blockKey( bi, bj, bk ) );
+    if( block == m_blocks.end() ){
+        return ( float ) m_bandWidth;
+    }
+    return block->second.phi[ ( ( i - bi * B ) * B + ( j - bj * B ) ) * B + ( k - bk * B ) ];
+}
+
+void LevelSet::localCell( const Vec3& x, Vec3i& cell, Vec3& frac ) const
+{
+    const Vec3 g = ( m_rotation.transpose() * ( x - m_translation ) - m_origin ) / m_cellSize;
+    for( short k = 0; k < 3; ++k )
+    {
+        const Scalar fl = std::floor( g[k] );
+        cell[k] = ( int ) fl;
+        frac[k] = g[k] - fl;
+    }
+}
+
+void LevelSet::cornerValues( const Vec3i& cell, float values[8] ) const
+{
+    for( int c = 0; c < 8; ++c ){
+        values[c] = nodeValue( cell[0] + ( c >> 2 ), cell[1] + ( ( c >> 1 ) & 1 ), cell[2] + ( c & 1 ) );
+    }
+}
+
+Scalar LevelSet::getValue( const Vec3& x ) const
+{
+    if( m_blocks.empty() ){
+        return m_bandWidth;
+    }
+
+    Vec3i cell;
+    Vec3 frac;
+    localCell( x, cell, frac );
+
+    float values[8];
+    cornerValues( cell, values );
+
+    Scalar phi = 0.;
+    for( int c = 0; c < 8; ++c )
+    {
+        const Scalar wx = ( c >> 2 ) ? frac[0] : 1. - frac[0];
+        const Scalar wy = ( ( c >> 1 ) & 1 ) ? frac[1] : 1. - frac[1];
+        const Scalar wz = ( c & 1 ) ? frac[2] : 1. - frac[2];
+        phi += wx * wy * wz * values[c];
+    }
+    return phi;
+}
+
+Vec3 LevelSet::getGradient( const Vec3& x ) const
+{
+    if( m_blocks.empty() ){
+        return Vec3::Zero();
+    }
+
+    Vec3i cell;
+    Vec3 frac;
+    localCell( x, cell, frac );
+
+    float values[8];
+    cornerValues( cell, values );
+
+    Vec3 grad = Vec3::Zero();
+    for( int c = 0; c < 8; ++c )
+    {
+        const int a = c >> 2, b = ( c >> 1 ) & 1, d = c & 1;
+        const Scalar wx = a ? frac[0] : 1. - frac[0];
+        const Scalar wy = b ? frac[1] : 1. - frac[1];
+        const Scalar wz = d ? frac[2] : 1. - frac[2];
+        grad[0] += ( a ? 1. : -1. ) * wy * wz * values[c];
+        grad[1] += ( b ? 1. : -1. ) * wx * wz * values[c];
+        grad[2] += ( d ? 1. : -1. ) * wx * wy * values[c];
+    }
+    return m_rotation * grad / m_cellSize;
+}
+
+Vec3 LevelSet::getRigidVelocity( const Vec3& x, Scalar dt ) const
+{
+    const Vec3 previous = m_lastRotation.transpose() * ( x - m_lastCenter - m_lastTranslate ) + m_lastCenter;
+    return ( x - previous ) / dt;
+}
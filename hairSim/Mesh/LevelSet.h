@@ -0,0 +1,92 @@
+#ifndef LEVELSET_HH_
+#define LEVELSET_HH_
+
+#include "../Utils/Definitions.h"
+
+#include <unordered_map>
+#include <stdint.h>
+
+class TriMesh;
+
+/* [H]
+    Narrow-band signed distance field of a TriMesh.
+    Distances are only stored in BLOCK_SIZE^3 blocks of voxels intersecting the band
+    around the surface; everywhere else the field reads as +bandWidth (outside).
+    The grid lives in its own frame, so rigidly scripted meshes only need
+    applyRigidTransform() instead of a rebuild.
+*/
+
+class LevelSet
+{
+public:
+    static const int BLOCK_SIZE = 8;
+
+    LevelSet();
+
+    void build( const TriMesh& mesh, Scalar cellSize, Scalar bandWidth );
+
+    //! Composes x -> rotation * ( x - center ) + center + translate with the current frame
+    void applyRigidTransform( const Mat3x& rotation, const Vec3& center, const Vec3& translate );
+
+    //! Trilinearly interpolated signed distance at world position x
+    Scalar getValue( const Vec3& x ) const;
+
+    //! World-space gradient of the trilinear interpolant at x (not normalized)
+    Vec3 getGradient( const Vec3& x ) const;
+
+    //! Velocity at x of the surface moved by the last rigid transform during dt
+    Vec3 getRigidVelocity( const Vec3& x, Scalar dt ) const;
+
+    bool isBuilt() const
+    { return !m_blocks.empty(); }
+
+    Scalar getCellSize() const
+    { return m_cellSize; }
+
+    Scalar getBandWidth() const
+    { return m_bandWidth; }
+
+    size_t numBlocks() const
+    { return m_blocks.size(); }
+
+private:
+    typedef Eigen::Matrix< int, 3, 1 > Vec3i;
+
+    struct Block
+    {
+        float phi[ BLOCK_SIZE * BLOCK_SIZE * BLOCK_SIZE ];
+    };
+    typedef std::unordered_map< int64_t, Block > Blocks;
+
+    static int floorDiv( int a, int b )
+    { return ( a >= 0 ? a : a - b + 1 ) / b; }
+
+    static int64_t blockKey( int bi, int bj, int bk )
+    {
+        // 21 bits per axis, offset so that negative block coordinates stay positive
+        return ( ( int64_t )( bi + ( 1 << 20 ) ) << 42 )
+            | ( ( int64_t )( bj + ( 1 << 20 ) ) << 21 )
+            | ( int64_t )( bk + ( 1 << 20 ) );
+    }
+
+    float nodeValue( int i, int j, int k ) const;
+    void localCell( const Vec3& x, Vec3i& cell, Vec3& frac ) const;
+    void cornerValues( const Vec3i& cell, float values[8] ) const;
+
+    Scalar m_cellSize;
+    Scalar m_bandWidth;
+    Vec3 m_origin;
+
+    // Grid to world frame: x = m_rotation * x_grid + m_translation
+    Mat3x m_rotation;
+    Vec3 m_translation;
+
+    // Last incremental transform, to get the surface velocity
+    Mat3x m_lastRotation;
+    Vec3 m_lastCenter;
+    Vec3 m_lastTranslate;
+
+    Blocks m_blocks;
+};
+
+#endif /* LEVELSET_HH_ */
@@ -1,5 +1,6 @@
 #include "TriMesh.h"
 #include "TriMeshController.h"
+#include "LevelSet.h"
 
 // Duration of guessed normal sign validity, in number of frames without query
 #define NORMAL_SIGN_VALIDITY 5
@@ -10,6 +11,8 @@ TriMeshController::TriMeshController( double i_time, double i_dt ):
     m_time( i_time),
     m_dt( i_dt ), 
     m_isStaticMesh( true ),
+    m_levelSet( NULL ),
+    m_levelSetDirty( false ),
     m_startMeshTime( 0. ), 
     m_endMeshTime( 0. ), 
     m_lastExecutionTime( 0 ), 
@@ -24,6 +27,8 @@ TriMeshController::~TriMeshController()
 {
     delete m_mesh;
     m_mesh = NULL;
+    delete m_levelSet;
+    m_levelSet = NULL;
 }
 
 void TriMeshController::isStaticMesh( const bool i_isStaticMesh )
@@ -33,9 +38,30 @@ void TriMeshController::isStaticMesh( const bool i_isStaticMesh )
 
 bool TriMeshController::execute( bool updateLevelSet )
 {
+    if( updateLevelSet && m_levelSet && m_levelSetDirty )
+    {
+        m_levelSet->build( *m_mesh, m_levelSet->getCellSize(), m_levelSet->getBandWidth() );
+        m_levelSetDirty = false;
+    }
     return true;
 }
 
+void TriMeshController::buildLevelSet( Scalar cellSize, Scalar bandWidth )
+{
+    if( !m_levelSet ){
+        m_levelSet = new LevelSet();
+    }
+    m_levelSet->build( *m_mesh, cellSize, bandWidth );
+    m_levelSetDirty = false;
+}
+
+void TriMeshController::transformLevelSet( const Mat3x& rotation, const Vec3& center, const Vec3& translate )
+{
+    if( m_levelSet && !m_levelSetDirty ){
+        m_levelSet->applyRigidTransform( rotation, center, translate );
+    }
+}
+
 short TriMeshController::knowsNormalSign( bool atPreviousStep, unsigned faceIndex,
                                             unsigned rodIndex, unsigned vertex )
 {
@@ -47,6 +73,7 @@ bool TriMeshController::loadMesh( std::string& obj_file_name )
     // intialize all triangular meshes
     ObjParser objparser;
     objparser.loadTriMesh( obj_file_name, *m_mesh);
+    m_meshFileName = obj_file_name;
     
     std::cout<< "# Loaded mesh: " << obj_file_name << std::endl;
     return true; 
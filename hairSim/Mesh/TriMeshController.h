@@ -17,6 +17,7 @@
 */
 
 class TriMesh;
+class LevelSet;
 
 class TriMeshController
 {
@@ -27,6 +28,12 @@ public:
     
     virtual void isStaticMesh( const bool i_isStaticMesh );
 
+    //! Static meshes never move, so their collision BVH is built only once
+    bool isStaticMesh() const
+    {
+        return m_isStaticMesh;
+    }
+
     virtual bool execute( bool updateLevelSet );
 
     const TriMesh* getMesh() const
@@ -56,9 +63,32 @@ public:
     
     bool loadMesh( std::string& obj_file_name );
 
+    //! Obj file the mesh was loaded from, empty if it was built procedurally
+    const std::string& getMeshFileName() const
+    {
+        return m_meshFileName;
+    }
+
     bool hasLevelSet() const
     {
-        return false;
+        return m_levelSet != NULL;
+    }
+
+    //! Voxelizes the mesh into a narrow-band signed distance field
+    void buildLevelSet( Scalar cellSize, Scalar bandWidth );
+
+    const LevelSet* getLevelSet() const
+    {
+        return m_levelSet;
+    }
+
+    //! Keeps the level set in sync with a rigid motion of the mesh, no rebuild needed
+    void transformLevelSet( const Mat3x& rotation, const Vec3& center, const Vec3& translate );
+
+    //! The mesh deformed; the level set will be rebuilt at the next execute( true )
+    void invalidateLevelSet()
+    {
+        m_levelSetDirty = true;
     }
     
     const std::vector<bool>& getEnabledVertices() const
@@ -114,6 +144,10 @@ private:
 
     bool m_isStaticMesh;
     TriMesh* m_mesh;
+    std::string m_meshFileName;
+
+    LevelSet* m_levelSet;
+    bool m_levelSetDirty;
 
     double m_startMeshTime;
     double m_endMeshTime;
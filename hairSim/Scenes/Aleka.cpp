@@ -2,7 +2,8 @@
 
 Aleka::Aleka() :
 Scene("Aleka", "Strands dragging orthogonally across other fixed strands"),
-m_radius(3.)
+m_radius(3.),
+m_frame(0)
 {
     AddOption( m_problemName, m_problemDesc, "" );
     
@@ -32,7 +33,6 @@ m_radius(3.)
 Aleka::~Aleka()
 {}
 
-std::vector<bool> frozen;
 void Aleka::setupStrands()
 {
     // discrete rod params
@@ -66,7 +66,7 @@ void Aleka::setupStrands()
     int layerTotal = fixed_rod_count + moving_rod_count;
     int layers = 1;
 
-    frozen.resize( layerTotal );
+    m_frozen.resize( layerTotal );
     for( int layer = 0; layer < layers; ++layer ){
 
     int rod_id;
@@ -101,7 +101,7 @@ void Aleka::setupStrands()
         controller->freezeVertices( 0, true );
         controller->freezeVertices( nVertices - 1 );
         
-        frozen[ layer * layerTotal + rod_id ] = true;
+        m_frozen[ layer * layerTotal + rod_id ] = true;
 
         ElasticStrandParameters* params = new ElasticStrandParameters( radiusA, youngsModulus, shearModulus, density, viscosity, airDrag, baseRotation );
         
@@ -150,7 +150,7 @@ void Aleka::setupStrands()
         
         ElasticStrandParameters* params = new ElasticStrandParameters( radiusA, youngsModulus, shearModulus, density, viscosity, airDrag, baseRotation );
         
-        frozen[ layer * layerTotal + rod_id ] = false;
+        m_frozen[ layer * layerTotal + rod_id ] = false;
 
 
         ElasticStrand* strand = new ElasticStrand( dofs, *params, controller );
@@ -166,17 +166,16 @@ void Aleka::setupStrands()
     std::cout << "num dofs per strand = " << nDOFs << std::endl << std::endl;
     
     // global body forces
-    GravitationForce::setGravity( GetVecOpt("gravity").cast<Scalar>() );
+    setGravity( GetVecOpt("gravity").cast<Scalar>() );
 }
 
 void Aleka::setupMeshes()
 {}
 
-int frame = 0;
 bool Aleka::executeScript()
 {
     if( getTime() > 8 ){
-        std::exit(0);
+        return false;
     }
 
     Vec3 zero(  0. , 0., 0. );
@@ -186,11 +185,11 @@ bool Aleka::executeScript()
     int count = 0;
     for(auto rd_itr = m_strands.begin(); rd_itr != m_strands.end(); ++ rd_itr)
     {
-        if( !frozen[count] ){
+        if( !m_frozen[count] ){
 
             // if ( getTime() < GetScalarOpt("time_moving") ){
             if ( getTime() < 0.25 ){
-            // if ( (frame / 10 ) % 3 == 0 ){
+            // if ( (m_frame / 10 ) % 3 == 0 ){
                 Vec3 translate = GetVecOpt("translation");
                 SceneUtils::transformRodRootVtx( *rd_itr, id, zero, translate, 0 );
             }
@@ -201,7 +200,7 @@ bool Aleka::executeScript()
         ++count;
     }
 
-    ++frame;
+    ++m_frame;
     return true;
 }
 
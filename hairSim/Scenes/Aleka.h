@@ -13,6 +13,8 @@ public:
     
 protected:
     Scalar m_radius;
+    std::vector<bool> m_frozen;
+    int m_frame;
     void setupStrands();
     void setupMeshes();
     bool executeScript();
@@ -6,7 +6,9 @@
 using namespace std;
 
 Braid::Braid() :
-Scene("Braid", "N Locks of hair forming a braid ")
+Scene("Braid", "N Locks of hair forming a braid "),
+m_includeTie( false ),
+m_nurbs( false )
 {
 
     AddOption("num_nurbs", "", 1500 );
@@ -173,11 +175,9 @@ void Braid::generateBraidVertices( vector< vector< Vec3 > >& rodPos )
     }
 }
 
-bool includeTie = false;
-
 void Braid::includeHairTie()
 {
-    includeTie = true;
+    m_includeTie = true;
 
 /*
     GetScalarOpt("density") = 1.32;
@@ -245,12 +245,10 @@ void Braid::includeHairTie()
 }
 
 
-int nVertices;
-static bool nurbs = false;
 void Braid::setupStrands()
 {
 
-    if( nurbs ){
+    if( m_nurbs ){
         loadNurbs();
         return;
     }
@@ -282,8 +280,6 @@ void Braid::setupStrands()
         vector< Vec3 > vertices = strands[i];
         num_DoFs = 4 * vertices.size() - 1;
 
-        nVertices = vertices.size();
-
         Scalar length = 0.0;
         for ( unsigned i = 0; i < vertices.size() - 1; i++ )
             length += ( vertices[i + 1] - vertices[i] ).norm();
@@ -432,17 +428,17 @@ bool Braid::executeScript()
 {
     if ( getTime() >= GetScalarOpt("end_time") )
     {
-        std::cout << "# Simulation complete. Exiting." << std::endl;
-        exit(0);
+        std::cout << "# Simulation complete." << std::endl;
+        return false;
     }
 
     Vec3 zero( 0.,0.,0. );
 
-    if( getTime() == 0.0 && includeTie )
+    if( getTime() == 0.0 && m_includeTie )
     {
         std::cout << "expanding hairtie" << std::endl;
     }
-    if( getTime() == 0.0 + m_dt && includeTie )
+    if( getTime() == 0.0 + m_dt && m_includeTie )
     {
         ElasticStrand* hairband = m_strands[ m_strands.size() - 1 ];
         Mat3x identity = Mat3x::Identity();
@@ -460,18 +456,18 @@ bool Braid::executeScript()
         // translate = Vec3( 0.0, 0.0, push );
         // transformRodRootVtx( *hairband, identity, zero, translate, 5 );
     }
-    if( getTime() == 0.0 + 2 * m_dt && includeTie )
+    if( getTime() == 0.0 + 2 * m_dt && m_includeTie )
     {
         ElasticStrand* hairband = m_strands[ m_strands.size() - 1 ];
         hairband->dynamics().getScriptingController()->clear();
     }
 
-    if( getTime() == 0.0 + 15 * m_dt && includeTie )
+    if( getTime() == 0.0 + 15 * m_dt && m_includeTie )
     {
         GetBoolOpt("useProxRodRodCollisions") = true;
     }
 
-    if( nurbs ) return true; // nurbs only have first vert scripted, below script expects both strand endpoints
+    if( m_nurbs ) return true; // nurbs only have first vert scripted, below script expects both strand endpoints
 
     
     double thetaxrate = GetScalarOpt("rotatescale") * 2. * M_PI;
@@ -19,5 +19,8 @@ protected:
     void setupStrands(); //TODO: virtual
     void setupMeshes(); //TODO: virtual
     bool executeScript(); // execute scripting and any per-step updating for problem
+
+    bool m_includeTie;
+    bool m_nurbs;
 };
 #endif 
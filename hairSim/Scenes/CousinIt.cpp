@@ -261,6 +261,7 @@ void CousinIt::setupMeshes()
 
     std::string file_name = GetStringOpt( "sphere_mesh_filename" ) ;
     mesh_controller->loadMesh(file_name);
+    mesh_controller->isStaticMesh( !GetBoolOpt( "scripting_on" ) );
 
     // set mu for mesh
     mesh_controller->setDefaultFrictionCoefficient( GetScalarOpt( "mesh_mu" ) ) ;
@@ -448,8 +449,8 @@ bool CousinIt::executeScript()
 
     if ( getTime() >= GetScalarOpt("end_time") )
     {
-        std::cout << "# Simulation complete. Exiting." << std::endl;
-        exit(0);
+        std::cout << "# Simulation complete." << std::endl;
+        return false;
     }
   
     return true;
@@ -0,0 +1,156 @@
+#include "FrameWriter.h"
+
+#include "Scene.h"
+#include "SceneUtils.h"
+#include "../Strand/ElasticStrand.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include <sys/stat.h>
+
+FrameWriter::FrameWriter( unsigned numSlots ):
+    m_slots( std::max( 1u, numSlots ) ),
+    m_first( 0 ),
+    m_count( 0 ),
+    m_running( true ),
+    m_numStalls( 0 )
+{
+    m_thread.run( this );
+}
+
+FrameWriter::~FrameWriter()
+{
+    flush();
+    {
+        LockGuard lock( m_mutex );
+        m_running = false;
+    }
+    m_pushed.notify_one();
+    m_thread.join();
+
+    if( m_numStalls > 0 ){
+        std::cout << "# FrameWriter: waited for a free slot " << m_numStalls << " time(s)" << std::endl;
+    }
+}
+
+void FrameWriter::push( const Scene& scene, const std::vector< TriMesh* >& meshes, const std::string& outputdirectory,
+        int frame, int file_width, bool withMeshes )
+{
+    unsigned slot;
+    {
+        UniqueLock lock( m_mutex );
+        if( m_count == m_slots.size() )
+        {
+            ++m_numStalls;
+            while( m_count == m_slots.size() ){
+                m_written.wait( lock );
+            }
+        }
+        slot = ( m_first + m_count ) % m_slots.size();
+    }
+
+    // The writer never touches a slot past m_first + m_count, so it can be filled unlocked
+    Snapshot& snapshot = m_slots[slot];
+    snapshot.m_outputdirectory = outputdirectory;
+    snapshot.m_frame = frame;
+    snapshot.m_fileWidth = file_width;
+    snapshot.m_time = scene.getTime();
+
+    // Ghosts of a distributed simulation are dumped by the processes owning them
+    const std::vector< ElasticStrand* >& strands = scene.getStrands();
+    const unsigned numStrands = scene.getNumOwnedStrands();
+    snapshot.m_vertexCounts.resize( numStrands );
+    int numVertices = 0;
+    for( unsigned s = 0; s < numStrands; ++s )
+    {
+        snapshot.m_vertexCounts[s] = strands[s]->getNumVertices();
+        numVertices += snapshot.m_vertexCounts[s];
+    }
+    // Keeps the capacity of the previous frames, so the copy does not allocate in steady state
+    snapshot.m_vertices.resize( numVertices );
+    int vtx = 0;
+    for( unsigned s = 0; s < numStrands; ++s )
+    {
+        for( int j = 0; j < snapshot.m_vertexCounts[s]; ++j ){
+            snapshot.m_vertices[vtx++] = strands[s]->getVertex( j );
+        }
+    }
+
+    snapshot.m_withMeshes = withMeshes;
+    if( withMeshes )
+    {
+        snapshot.m_meshVertices.resize( meshes.size() );
+        snapshot.m_meshFaces.resize( meshes.size() );
+        for( unsigned m = 0; m < meshes.size(); ++m )
+        {
+            const TriMesh* mesh = meshes[m];
+            snapshot.m_meshVertices[m].resize( mesh->nv() );
+            for( size_t v = 0; v < mesh->nv(); ++v ){
+                snapshot.m_meshVertices[m][v] = mesh->getVertex( v );
+            }
+            snapshot.m_meshFaces[m] = mesh->getFaces();
+        }
+    }
+
+    {
+        LockGuard lock( m_mutex );
+        ++m_count;
+    }
+    m_pushed.notify_one();
+}
+
+void FrameWriter::flush()
+{
+    UniqueLock lock( m_mutex );
+    while( m_count > 0 ){
+        m_written.wait( lock );
+    }
+}
+
+void FrameWriter::operator()()
+{
+    while( true )
+    {
+        unsigned slot;
+        {
+            UniqueLock lock( m_mutex );
+            while( m_running && m_count == 0 ){
+                m_pushed.wait( lock );
+            }
+            if( m_count == 0 ){
+                return;
+            }
+            slot = m_first;
+        }
+
+        write( m_slots[slot] );
+
+        {
+            LockGuard lock( m_mutex );
+            m_first = ( m_first + 1 ) % m_slots.size();
+            --m_count;
+        }
+        m_written.notify_all();
+    }
+}
+
+void FrameWriter::write( const Snapshot& snapshot ) const
+{
+    mkdir( snapshot.m_outputdirectory.c_str(), 0755 );
+
+    SceneUtils::writeRods( SceneUtils::rodsFileName( snapshot.m_outputdirectory, snapshot.m_frame, snapshot.m_fileWidth ),
+            snapshot.m_vertexCounts, snapshot.m_vertices );
+
+    if( snapshot.m_withMeshes )
+    {
+        for( unsigned m = 0; m < snapshot.m_meshVertices.size(); ++m )
+        {
+            SceneUtils::writeMesh( SceneUtils::meshFileName( snapshot.m_outputdirectory, m, snapshot.m_frame, snapshot.m_fileWidth ),
+                    snapshot.m_meshVertices[m], snapshot.m_meshFaces[m] );
+        }
+    }
+
+    std::cout << "Saved coordinates of frame: " << snapshot.m_frame << " @ time: "
+        << snapshot.m_time << " in directory " << snapshot.m_outputdirectory << std::endl;
+}
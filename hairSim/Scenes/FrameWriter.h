@@ -0,0 +1,73 @@
+#ifndef FRAMEWRITER_H_
+#define FRAMEWRITER_H_
+
+#include "../Utils/Definitions.h"
+#include "../Utils/ThreadUtils.h"
+#include "../Mesh/TriMesh.h"
+
+#include <string>
+#include <vector>
+
+class Scene;
+
+/* [H]
+    Writes the frames dumped by the application on a background thread.
+    push() copies the strand and mesh vertices into one slot of a ring of preallocated
+    snapshots and returns, so the next frame can be simulated while the previous
+    ones are formatted and written to disk.
+    When every slot is waiting to be written, push() blocks until the writer frees one.
+    Files are the same as those of Scene::dumpRods() and SceneUtils::dumpMesh().
+*/
+
+class FrameWriter
+{
+public:
+    explicit FrameWriter( unsigned numSlots = 2 );
+
+    //! Flushes the pending frames and stops the writer thread
+    ~FrameWriter();
+
+    //! Snapshots the current state of \p scene as frame \p frame, to be written into \p outputdirectory
+    void push( const Scene& scene, const std::vector< TriMesh* >& meshes, const std::string& outputdirectory,
+            int frame, int file_width, bool withMeshes );
+
+    //! Blocks until every pushed frame has been written
+    void flush();
+
+    //! Number of push() calls that had to wait for a free slot
+    unsigned numStalls() const
+    { return m_numStalls; }
+
+    void operator()();
+
+private:
+    struct Snapshot
+    {
+        std::string m_outputdirectory;
+        int m_frame;
+        int m_fileWidth;
+        Scalar m_time;
+
+        std::vector< int > m_vertexCounts;
+        std::vector< Vec3 > m_vertices;
+
+        bool m_withMeshes;
+        std::vector< std::vector< Vec3 > > m_meshVertices;
+        std::vector< std::vector< TriangularFace > > m_meshFaces;
+    };
+
+    void write( const Snapshot& snapshot ) const;
+
+    std::vector< Snapshot > m_slots;
+    unsigned m_first; //!< Oldest slot not written yet
+    unsigned m_count; //!< Number of slots waiting to be written, the one being written included
+    bool m_running;
+    unsigned m_numStalls;
+
+    MutexType m_mutex;
+    Condition m_pushed;
+    Condition m_written;
+    ThreadHandle m_thread;
+};
+
+#endif /* FRAMEWRITER_H_ */
@@ -202,7 +202,7 @@ void Knot::setupStrands()
     std::cout << "num strands = " << m_strands.size() <<'\n';
     std::cout << "num dofs per strand = " << nDOFs <<'\n';
     
-    GravitationForce::setGravity( GetVecOpt("gravity").cast<Scalar>() );
+    setGravity( GetVecOpt("gravity").cast<Scalar>() );
 }
 
 void Knot::setupMeshes()
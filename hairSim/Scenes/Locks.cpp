@@ -5,7 +5,9 @@
 using namespace std;
 
 Locks::Locks():
-Scene("Locks", "L Locks of hair forming an N braid")
+Scene("Locks", "L Locks of hair forming an N braid"),
+m_hairtieNum( -1 ),
+m_includeLockTie( false )
 {
     AddOption("lock_radius", "", 1.6 );
 
@@ -116,11 +118,9 @@ void Locks::layeredLockPacking( std::vector< std::vector< Vec3 > >& rodPos )
 
 }
 
-int hairtieNum = -1;
-bool includeLockTie = false;
 void Locks::includeHairTie()
 {
-    includeLockTie = true;
+    m_includeLockTie = true;
 
     // rod options
     Scalar radiusA = GetScalarOpt("radius");
@@ -151,7 +151,7 @@ void Locks::includeHairTie()
     ElasticStrandParameters* params = new ElasticStrandParameters( radiusA, youngsModulus, shearModulus, density, viscosity, airDrag, baseRotation );
     ElasticStrand* strand = new ElasticStrand( dofs, *params, controller, 0.15 );
     strand->setGlobalIndex( m_strands.size() );
-    hairtieNum = m_strands.size();
+    m_hairtieNum = m_strands.size();
     setRodCollisionParameters( *strand );
 
     m_strands.push_back( strand );
@@ -239,12 +239,12 @@ bool Locks::executeScript()
 {
     if ( getTime() >= GetScalarOpt("end_time") )
     {
-        std::cout << "# Simulation complete. Exiting." << std::endl;
-        exit(0);
+        std::cout << "# Simulation complete." << std::endl;
+        return false;
     }
 
     Vec3 zero( 0.,0.,0. );
-    if( getTime() == 0.0 + m_dt && includeLockTie )
+    if( getTime() == 0.0 + m_dt && m_includeLockTie )
     {
         std::cout << "expanding hairtie" << std::endl;
         ElasticStrand* hairband = m_strands[ m_strands.size() - 1 ];
@@ -262,7 +262,7 @@ bool Locks::executeScript()
         SceneUtils::transformRodRootVtx( hairband, identity, zero, translate, 4 );
     }
 
-    if( getTime() == 0.0 + 2 * m_dt && includeLockTie )
+    if( getTime() == 0.0 + 2 * m_dt && m_includeLockTie )
     {
         ElasticStrand* hairband = m_strands[ m_strands.size() - 1 ];
         hairband->dynamics().getScriptingController()->clear();
@@ -298,11 +298,11 @@ bool Locks::executeScript()
             int rodCount = 0;
             for(auto rd_itr = m_strands.begin(); rd_itr != m_strands.end(); ++rd_itr, ++rodCount)
             {
-                if( rodCount == hairtieNum ) continue; // hairtie
+                if( rodCount == m_hairtieNum ) continue; // hairtie
                 SceneUtils::transformRodRootVtx( *rd_itr, identity, zero, translate, 0 );
             }
         }
-        else if( scriptType == 3 && getTime() > 0.0 + 5000 * m_dt  && includeLockTie )
+        else if( scriptType == 3 && getTime() > 0.0 + 5000 * m_dt  && m_includeLockTie )
         { // Move hairtie
             double swayRate = 20 * M_PI;
 
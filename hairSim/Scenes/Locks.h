@@ -18,5 +18,8 @@ protected:
     void setupStrands(); //TODO: virtual
     void setupMeshes(); //TODO: virtual
     bool executeScript(); // execute scripting and any per-step updating for problem
+
+    int m_hairtieNum;
+    bool m_includeLockTie;
 };
 #endif 
@@ -136,7 +136,7 @@ void MultipleContact::setupStrands()
     std::cout << "num strands = " << m_strands.size() <<'\n';
     std::cout << "num dofs per strand = " << nDOFs <<'\n';
     
-    GravitationForce::setGravity( GetVecOpt("gravity").cast<Scalar>() );
+    setGravity( GetVecOpt("gravity").cast<Scalar>() );
 }
 
 void MultipleContact::setupMeshes()
@@ -192,6 +192,7 @@ void Playback::loadMeshes(int frame)
         {
             TriMeshController* mesh = new TriMeshController( 0., m_dt );
             mesh->loadMesh( mesh_name );
+            mesh->isStaticMesh( false );
 
             m_meshes.push_back( mesh->getMesh() );
             TriMeshRenderer* mesh_renderer = new TriMeshRenderer( *(mesh->getMesh()) );
@@ -209,6 +210,7 @@ void Playback::loadMeshes(int frame)
             {
                 currentMesh->setVertex( i, mesh->getMesh()->getVertex(i) );
             }
+            currentMesh->controller()->invalidateLevelSet();
             delete mesh;
             mesh = NULL;
         }
@@ -286,8 +288,8 @@ bool Playback::executeScript()
     }
     else {
         {
-            std::cout << "Playback complete. Exiting." << std::endl;
-            exit(0);
+            std::cout << "Playback complete." << std::endl;
+            return false;
         }
     }
     return true;
@@ -15,6 +15,11 @@
 #include "../Collision/ElementProxy.h"
 #include "../Collision/CollisionDetector.h"
 #include "../Simulation/Simulation.h"
+#include "../Simulation/HaloExchange.h"
+#include "../Strand/ElasticStrandUtils.h"
+#include "../Utils/ThreadPool.h"
+#include "../Utils/LocalSocketTransport.h"
+#include "../Utils/Profiler.h"
 
 #define EIGEN_RAW 0
 #define EIGEN_SPACES_ONLY_IO Eigen::IOFormat(8, EIGEN_RAW, " ", " ", "", "", "", "")
@@ -25,6 +30,8 @@ Scene::Scene( const std::string& name, const std::string& desc )
 , m_t( 0. ) // start time
 , m_isSimulated( true )
 , m_strandsManager( NULL )
+, m_transport( NULL )
+, m_halo( NULL )
 {
     addOptions();
     m_renderer = new StrandRenderer();
@@ -46,6 +53,9 @@ Scene::~Scene()
       m_strands[i] = NULL;
     }
   }
+
+  delete m_halo;
+  delete m_transport;
   
   for( std::vector< TriMesh* >::size_type i = 0; i < m_meshes.size(); ++i )
   {
@@ -66,30 +76,141 @@ void Scene::setup()
     setupStrands();
     setupMeshes();
     setSimulationParameters();
-    
+
+    if( m_isSimulated && GetIntOpt( "distributedProcesses" ) > 1 )
+    {
+        // Processes are forked before any thread is started, so before the level sets are built, and each one keeps its part of the scene
+        ThreadPool::instance().resize( 1 );
+        m_transport = LocalSocketTransport::fork( GetIntOpt( "distributedProcesses" ) );
+        if( !m_transport )
+        {
+            std::cerr << "Could not start " << GetIntOpt( "distributedProcesses" ) << " processes" << std::endl;
+            exit( -1 );
+        }
+        m_halo = new HaloExchange( *m_transport, ( HaloExchange::PartitionMode ) GetIntOpt( "distributedPartition" ), GetScalarOpt( "haloWidth" ) );
+        m_halo->partition( m_strands );
+    }
+
+    if( GetScalarOpt( "levelSetCellSize" ) > 0. )
+    {
+        const Scalar cellSize = GetScalarOpt( "levelSetCellSize" );
+        for( unsigned m = 0; m < m_meshes.size(); ++m ){
+            m_meshes[m]->controller()->buildLevelSet( cellSize, GetIntOpt( "levelSetBandCells" ) * cellSize );
+        }
+    }
+
     if( m_isSimulated ){
         // Enforce desired or maximum number of threads
         {
             const int numThreads = m_simulation_params.m_numberOfThreads > 0 ? m_simulation_params.m_numberOfThreads : sysconf( _SC_NPROCESSORS_ONLN );
             omp_set_num_threads( numThreads );
+            ThreadPool::instance().resize( numThreads );
+            if( m_simulation_params.m_numaMode )
+            {
+                const unsigned numNodes = ThreadPool::instance().pinThreads();
+                std::cout << "# numa_nodes: " << numNodes << std::endl;
+            }
         }
         m_strandsManager = new Simulation( m_strands, m_simulation_params, m_meshes );
     }
+
+    if( !GetStringOpt( "profileFile" ).empty() )
+    {
+#ifdef HAIRSIM_PROFILE
+        Profiler::open( processFileName( GetStringOpt( "profileFile" ) ) );
+#else
+        std::cerr << "profileFile is ignored, the profiler is not compiled in ( build with -DHAIRSIM_PROFILE=ON )" << std::endl;
+#endif
+    }
+
+    if( m_isSimulated && !GetStringOpt( "metricsFile" ).empty() )
+    {
+        const std::string metricsFile = processFileName( GetStringOpt( "metricsFile" ) );
+        m_metricsFile.open( metricsFile.c_str() );
+        if( !m_metricsFile.is_open() ){
+            std::cerr << "Could not open metrics file " << metricsFile << std::endl;
+        }
+    }
+}
+
+std::string Scene::processFileName( const std::string& filename ) const
+{
+    if( !m_transport ){
+        return filename;
+    }
+    // Before the extension
+    std::stringstream name;
+    const std::string::size_type dot = filename.rfind( '.' );
+    name << filename.substr( 0, dot ) << "_rank" << rank() << ( dot == std::string::npos ? "" : filename.substr( dot ) );
+    return name.str();
 }
 
 bool Scene::step()
 {
     std::cout << "\n# Stepping @ time: " << m_t << "\n";
 
-    executeScript();
+    {
+        PROFILE_SCOPE( "script" );
+        if( !executeScript() ){
+            return false;
+        }
+    }
+    if( m_halo )
+    {
+        PROFILE_SCOPE( "halo exchange" );
+        if( !m_halo->exchange() )
+        {
+            std::cerr << "Process " << rank() << " lost its neighbours, stopping" << std::endl;
+            return false;
+        }
+        if( m_isSimulated ){
+            m_strandsManager->setActiveStrands( m_halo->activeStrands() );
+        }
+    }
     if( m_isSimulated ){
         m_strandsManager->step( m_dt );
     }
 
     m_t += m_dt;    
+    if( m_metricsFile.is_open() )
+    {
+        m_strandsManager->metrics().write( m_metricsFile, floor( m_t / m_dt + 0.5 ), m_t );
+        m_metricsFile.flush();
+    }
+#ifdef HAIRSIM_PROFILE
+    Profiler::endStep( floor( m_t / m_dt + 0.5 ), m_t );
+#endif
     return true;
 }
 
+unsigned Scene::getNumOwnedStrands() const
+{
+    return m_halo ? m_halo->numOwned() : m_strands.size();
+}
+
+int Scene::rank() const
+{
+    return m_transport ? m_transport->rank() : 0;
+}
+
+bool Scene::hasNans() const
+{
+    for( unsigned s = 0; s < getNumOwnedStrands(); ++s )
+    {
+        if( containsNans( m_strands[s]->getCurrentDegreesOfFreedom() ) ){
+            return true;
+        }
+    }
+    return false;
+}
+
+void Scene::setGravity( const Vec3& gravity )
+{
+    for( auto sptr = m_strands.begin(); sptr != m_strands.end(); ++sptr ){
+        (*sptr)->setGravity( gravity );
+    }
+}
+
 void Scene::clearContacts()
 {
     m_renderer->verts.clear();
@@ -130,6 +251,9 @@ void Scene::addOptions()
     AddOption( "mesh_mu" , "" , 0.3 );
 
     AddOption( "rootImmunityLength" , "how much of the base of the strand to ignore" , 0.3 );
+    AddOption( "levelSetCellSize" , "voxel size of mesh signed distance fields, 0 to use CT face collisions instead" , 0. );
+    AddOption( "levelSetBandCells" , "half-width of the level set narrow band, in voxels" , 3 );
+    AddOption( "cacheStaticMeshBVH" , "store/reuse the BVH of static meshes next to their obj file" , false );
         
     // for implicit solve :
     AddOption("useGraphSplitOption", "whether to use graph split for large problems", false );
@@ -149,9 +273,32 @@ void Scene::addOptions()
     // sys options
     AddOption("numberOfThreads","",4);
     AddOption("simulationManager_limitedMemory","", false);
+    AddOption("numaMode", "pin threads to cores and keep each strand's data on the NUMA node of its home thread", false );
+    AddOption("profileFile", "per-step timings of the profiler, as CSV or JSON lines if it ends with .json; needs a HAIRSIM_PROFILE build", "" );
+    AddOption("metricsFile", "per-step counters and histograms of the simulation, as JSON lines", "" );
+    AddOption("distributedProcesses", "number of processes the strands are split between", 1 );
+    AddOption("distributedPartition", "0 to split the strands by their roots, 1 by their centers", 0 );
+    AddOption("haloWidth", "distance within which the strands of other processes are mirrored as ghosts", 1. );
     
     //
     AddOption("gaussSeidelTolerance","", 1e-5 );
+    AddOption("warmStartImpulses", "start GS from the impulses of the previous step", true );
+    AddOption("warmStartAbscissaTolerance", "max. edge abscissa drift for contacts to be matched across steps", 0.2 );
+    AddOption("coloredGSContactThreshold", "min. number of contacts of a group for a colored, multithreaded GS (0 to disable)", 2000 );
+    AddOption("domainDecompositionMinStrands", "min. number of strands of a group to be split into subdomains (0 to disable)", 0 );
+    AddOption("domainDecompositionSubdomains", "number of subdomains (0 for twice the number of threads)", 0 );
+    AddOption("domainDecompositionMaxIters", "max. number of sweeps over the subdomains", 20 );
+    AddOption("useProjectedGradient", "solve friction with an accelerated projected gradient instead of GS", false );
+    AddOption("cadouxIterations", "number of Cadoux fixed-point iterations for the projected gradient", 10 );
+    AddOption("matrixFreeContactThreshold", "min. number of contacts of a group to be solved without assembling the Delassus operator (0 to disable)", 0 );
+    AddOption("failsafePredictionThreshold", "decayed count of recent failsafes above which a group skips the coupled solve (0 to disable)", 0. );
+    AddOption("contactReductionWindow", "max. distance in edges between rod-rod contacts of a strand pair merged into one (0 to disable)", 0. );
+
+    // tunneling
+    AddOption("hLoop", "re-solve collisions while some CT collisions are left unresolved", false );
+    AddOption("trackGeometricRelations", "track missed collisions as twisted bands", true );
+    AddOption("penaltyAfter", "apply the penalty of twisted bands after the step", true );
+    AddOption("penaltyOnce", "delete twisted bands once their penalty has been applied", true );
 }
 
 void Scene::setSimulationParameters()
@@ -169,7 +316,24 @@ void Scene::setSimulationParameters()
     m_simulation_params.m_maxNewtonIterations = GetIntOpt( "maxNewtonIterations" );
 
     m_simulation_params.m_simulationManager_limitedMemory = GetBoolOpt( "simulationManager_limitedMemory" );
+    m_simulation_params.m_numaMode = GetBoolOpt( "numaMode" );
     m_simulation_params.m_gaussSeidelTolerance = GetScalarOpt( "gaussSeidelTolerance" );
+    m_simulation_params.m_warmStartImpulses = GetBoolOpt( "warmStartImpulses" );
+    m_simulation_params.m_warmStartAbscissaTolerance = GetScalarOpt( "warmStartAbscissaTolerance" );
+    m_simulation_params.m_coloredGSContactThreshold = GetIntOpt( "coloredGSContactThreshold" );
+    m_simulation_params.m_domainDecompositionMinStrands = GetIntOpt( "domainDecompositionMinStrands" );
+    m_simulation_params.m_domainDecompositionSubdomains = GetIntOpt( "domainDecompositionSubdomains" );
+    m_simulation_params.m_domainDecompositionMaxIters = GetIntOpt( "domainDecompositionMaxIters" );
+    m_simulation_params.m_useProjectedGradient = GetBoolOpt( "useProjectedGradient" );
+    m_simulation_params.m_cadouxIterations = GetIntOpt( "cadouxIterations" );
+    m_simulation_params.m_matrixFreeContactThreshold = GetIntOpt( "matrixFreeContactThreshold" );
+    m_simulation_params.m_failsafePredictionThreshold = GetScalarOpt( "failsafePredictionThreshold" );
+    m_simulation_params.m_contactReductionWindow = GetScalarOpt( "contactReductionWindow" );
+    m_simulation_params.m_hLoop = GetBoolOpt( "hLoop" );
+    m_simulation_params.m_trackGeometricRelations = GetBoolOpt( "trackGeometricRelations" );
+    m_simulation_params.m_penaltyAfter = GetBoolOpt( "penaltyAfter" );
+    m_simulation_params.m_penaltyOnce = GetBoolOpt( "penaltyOnce" );
+    m_simulation_params.m_cacheStaticMeshBVH = GetBoolOpt( "cacheStaticMeshBVH" );
 }
 
 void Scene::setRodCollisionParameters( ElasticStrand& strand )
@@ -188,9 +352,12 @@ void Scene::render( const int& w, const int& h, const int& l, const bool& ct )
 {
     clearContacts();
 
-    for( auto sptr = m_strands.begin(); sptr != m_strands.end(); ++sptr )
+    // Ghosts outside of the halo are not updated
+    for( unsigned s = 0; s < m_strands.size(); ++s )
     {
-        m_renderer->render( *sptr, w, h, l, ct );
+        if( !m_halo || m_halo->activeStrands()[s] ){
+            m_renderer->render( m_strands[s], w, h, l, ct );
+        }
     }
     
     for(auto m_itr = m_mesh_renderers.begin(); m_itr != m_mesh_renderers.end(); ++ m_itr)
@@ -356,32 +523,18 @@ void Scene::PrintOptions(std::ostream& os)
 void Scene::dumpRods( std::string outputdirectory, int current_frame, int file_width ) const
 {
     mkdir(outputdirectory.c_str(), 0755);
-    
-    std::stringstream name;
-    name << std::setfill('0');
-    name << outputdirectory << "/rods_" << std::setw(file_width) << current_frame << ".ply";
-    std::ofstream os(name.str().c_str());
-    
-    // header
-    os << "ply" << std::endl << "format ascii 1.0" <<std::endl << "comment created by BASim" << std::endl;
-    int num_verts = 0;
-    for( auto sptr = m_strands.begin(); sptr != m_strands.end(); ++sptr )
-    {
-        num_verts += (*sptr)->getNumVertices();
-    }
-    os << "element vertex " << num_verts << std::endl;
-    os << "property float x"<< std::endl << "property float y"<< std::endl << "property float z" << std::endl
-     << "property int segment" << std::endl << "element face 0"<< std::endl << "property list int int vertex_indices" << std::endl << "end_header " << std::endl;
 
-    // rod vertex positions
-    int rod_num = 0;
-    for( auto sptr = m_strands.begin(); sptr != m_strands.end(); ++sptr, ++rod_num)
+    std::vector< int > vertexCounts;
+    std::vector< Vec3 > vertices;
+    for( auto sptr = m_strands.begin(); sptr != m_strands.begin() + getNumOwnedStrands(); ++sptr )
     {
+        vertexCounts.push_back( (*sptr)->getNumVertices() );
         for (int j = 0; j < (*sptr)->getNumVertices(); ++j)
         {
-            os << (*sptr)->getVertex(j).x() << " " << (*sptr)->getVertex(j).y() << " " << (*sptr)->getVertex(j).z() << " " << rod_num <<std::endl;
+            vertices.push_back( (*sptr)->getVertex(j) );
         }
     }
+    SceneUtils::writeRods( SceneUtils::rodsFileName( outputdirectory, current_frame, file_width ), vertexCounts, vertices );
 }
 
 
@@ -501,7 +654,7 @@ void Scene::checkpointSave( std::string outputdirectory ) const
 
     }
 
-    serializeVarHex( edgeCounter, os );
+    serializeVarHex( m_strandsManager->m_collisionDetector->m_proxyHistory->m_edgeCounter, os );
     serializeVarHex( numOrRods, os);
 
     // print out twist bands and all their info
@@ -529,8 +682,7 @@ void Scene::checkpointSave( std::string outputdirectory ) const
     os.close();
 }
 
-static int numOriginalRods;
-bool nonOriginal( ElementProxy* ep )
+static bool nonOriginal( ElementProxy* ep, int numOriginalRods )
 {
     TwistEdge* twist = dynamic_cast< TwistEdge* >( ep );
     //    return twist->uniqueID >= numOriginalRods;
@@ -663,14 +815,13 @@ void Scene::checkpointRestore()
         sptr->setFutureReferenceTwistsClean( FutureReftwists );
     }
 
-    deserializeVarHex( edgeCounter, in );
+    deserializeVarHex( m_strandsManager->m_collisionDetector->m_proxyHistory->m_edgeCounter, in );
     int numOrRods;
     deserializeVarHex( numOrRods, in);
 
     unsigned numTunneledBands;
     deserializeVarHex( numTunneledBands, in );
 
-    numOriginalRods = numOrRods;
 
     std::vector< TwistEdge* >& tunneledBands = m_strandsManager->m_collisionDetector->m_proxyHistory->tunnelingBands;
     std::vector<ElementProxy*>& originalTE = m_strandsManager->m_collisionDetector->m_elementProxies;
@@ -685,7 +836,7 @@ void Scene::checkpointRestore()
     }   
 
     // need to clear elementproxies past the original ones...
-    originalTE.erase( std::remove_if(originalTE.begin(), originalTE.end(), nonOriginal), originalTE.end() );
+    originalTE.erase( std::remove_if(originalTE.begin(), originalTE.end(), [numOrRods]( ElementProxy* ep ){ return nonOriginal( ep, numOrRods ); } ), originalTE.end() );
 
     deserializeVarHex( numOrRods, in );
 
@@ -17,7 +17,10 @@
 #include "SceneUtils.h"
 #include "../Utils/Definitions.h"
 
-extern int edgeCounter;
+#include <fstream>
+
+class Transport;
+class HaloExchange;
 
 class Scene
 {
@@ -27,7 +30,7 @@ public:
     virtual ~Scene();
     
     void setup();
-    bool step();
+    bool step(); // returns false once the scene is complete
     void render( const int& w, const int& h, const int& l, const bool& ct );
 
     // Scene Options:
@@ -65,10 +68,10 @@ public:
     
     void setSimulationParameters();
         
-    Scalar getTime(){ return m_t; }
+    Scalar getTime() const { return m_t; }
     void setTime( Scalar t){ m_t = t; }
     
-    Scalar getDt(){ return m_dt; }
+    Scalar getDt() const { return m_dt; }
     void setDt( Scalar dt) { m_dt = dt; }
         
     // output
@@ -78,6 +81,16 @@ public:
     void checkpointRestore();
 
     std::vector< TriMesh* >& getMeshes(){ return m_meshes; }
+    const std::vector< ElasticStrand* >& getStrands() const { return m_strands; }
+    //! Number of strands stepped by this process; in a distributed simulation they are followed by ghosts
+    unsigned getNumOwnedStrands() const;
+    //! Index of this process in a distributed simulation, 0 otherwise
+    int rank() const;
+
+    //! NULL if the scene is not simulated
+    Simulation* getSimulation() { return m_strandsManager; }
+    //! Whether some owned strand has NaN degrees of freedom
+    bool hasNans() const;
 
     std::string m_problemName;
     std::string m_problemDesc;    
@@ -88,11 +101,15 @@ protected:
     
     virtual void setupStrands() = 0;
     virtual void setupMeshes() = 0;    
-    virtual bool executeScript() = 0; // execute scripting and any per-step updates
+    virtual bool executeScript() = 0; // execute scripting and any per-step updates, returns false once the scene is complete
 
     void setRodCollisionParameters( ElasticStrand& strand );
+    //! Sets the gravity of all the strands of the scene
+    void setGravity( const Vec3& gravity );
     void addOptions();
     void clearContacts();
+    //! \p filename, with the index of this process before its extension in a distributed simulation
+    std::string processFileName( const std::string& filename ) const;
 
     ///////////////////////////
 
@@ -108,5 +125,10 @@ protected:
     StrandRenderer* m_renderer;
     std::vector< TriMeshRenderer* > m_mesh_renderers;
 
+    Transport* m_transport; // only for distributed simulations
+    HaloExchange* m_halo;
+
+    std::ofstream m_metricsFile;
+
 };
 #endif
@@ -1,6 +1,15 @@
 #include "SceneUtils.h"
 #include "Scene.h"
+#include "Aleka.h"
+#include "Braid.h"
+#include "CousinIt.h"
+#include "Knot.h"
+#include "Locks.h"
+#include "MultipleContact.h"
+#include "PlayBack.h"
+#include "SingleContact.h"
 #include "../Utils/Option.h"
+#include "../Mesh/TriMeshController.h"
 #include "boost/random.hpp"
 #include "boost/generator_iterator.hpp"
 #include <sys/stat.h>
@@ -8,6 +17,42 @@
 #include <fstream>
 #define EPSILON 1.0e-12
 
+Scene* SceneUtils::createScene( int problemIdx )
+{
+    Scene* scene = NULL;
+    switch( problemIdx )
+    {
+        case 1:
+            scene = new CousinIt();
+            break;
+        case 2:
+            scene = new Playback();
+            scene->isSimulated( false );
+            break;
+        case 3:
+            scene = new SingleContact();
+            break;
+        case 4:
+            scene = new Aleka();
+            break;
+        case 5:
+            scene = new Knot(); // Not Tested, has tunneling
+            break;
+        case 6:
+            scene = new MultipleContact();
+            break;
+        case 7:
+            scene = new Braid();
+            break;
+        case 8:
+            scene = new Locks();
+            break;
+        default:
+            break;
+    }
+    return scene;
+}
+
 void SceneUtils::findOrthogonal( Vec3& v, const Vec3& u )
 {
     assert(u.norm() != 0);
@@ -96,6 +141,10 @@ void SceneUtils::transformTriangleObject( TriMesh& triMesh, Mat3x& transformatio
         triMesh.setVertex(i, vertNext);
         triMesh.setDisplacement( i, (vertNext-vert) );
     }
+
+    if( triMesh.controller() && triMesh.controller()->hasLevelSet() ){
+        triMesh.controller()->transformLevelSet( transformation, center, translate );
+    }
 }
 
 void SceneUtils::freezeTriangleObject( TriMesh& triMesh )
@@ -105,6 +154,11 @@ void SceneUtils::freezeTriangleObject( TriMesh& triMesh )
     {
         triMesh.setDisplacement( i, disp );
     }
+
+    // Still mesh: the level set keeps its frame but has no velocity anymore
+    if( triMesh.controller() && triMesh.controller()->hasLevelSet() ){
+        triMesh.controller()->transformLevelSet( Mat3x::Identity(), disp, disp );
+    }
 }
 
 void SceneUtils::transformRodRoot( ElasticStrand* strand, Mat3x& transformation, Vec3& center, Vec3& translate )
@@ -148,24 +202,68 @@ void SceneUtils::dumpMesh( std::string outputdirectory, int current_frame, int f
     for( auto m_itr = meshes.begin(); m_itr != meshes.end(); ++ m_itr, ++ mesh_num )
     {
         // new obj per mesh
-        std::stringstream name;
-        name << std::setfill('0');
-        name << outputdirectory << "/mesh" <<  mesh_num << "_" << std::setw(file_width) << current_frame << ".obj";
-        std::ofstream os(name.str().c_str());
-        // header
-        os << "# obj created by HairSim" << std::endl;
-        // vertices
         TriMesh* mesh = *m_itr;
+        std::vector< Vec3 > vertices( mesh->nv() );
         for ( size_t v = 0; v < mesh->nv(); ++v )
         {
-            os << "v " << mesh->getVertex(v).x() << " " << mesh->getVertex(v).y() << " " << mesh->getVertex(v).z() << std::endl;
+            vertices[v] = mesh->getVertex(v);
         }
-        // triangles
-        for(auto f_itr = mesh->getFaces().begin(); f_itr != mesh->getFaces().end(); ++ f_itr)
+        writeMesh( meshFileName( outputdirectory, mesh_num, current_frame, file_width ), vertices, mesh->getFaces() );
+    }
+}
+
+std::string SceneUtils::rodsFileName( const std::string& outputdirectory, int current_frame, int file_width )
+{
+    std::stringstream name;
+    name << std::setfill('0');
+    name << outputdirectory << "/rods_" << std::setw(file_width) << current_frame << ".ply";
+    return name.str();
+}
+
+std::string SceneUtils::meshFileName( const std::string& outputdirectory, int mesh_num, int current_frame, int file_width )
+{
+    std::stringstream name;
+    name << std::setfill('0');
+    name << outputdirectory << "/mesh" <<  mesh_num << "_" << std::setw(file_width) << current_frame << ".obj";
+    return name.str();
+}
+
+void SceneUtils::writeRods( const std::string& fileName, const std::vector< int >& vertexCounts, const std::vector< Vec3 >& vertices )
+{
+    std::ofstream os( fileName.c_str() );
+
+    // header
+    os << "ply" << std::endl << "format ascii 1.0" <<std::endl << "comment created by BASim" << std::endl;
+    os << "element vertex " << vertices.size() << std::endl;
+    os << "property float x"<< std::endl << "property float y"<< std::endl << "property float z" << std::endl
+     << "property int segment" << std::endl << "element face 0"<< std::endl << "property list int int vertex_indices" << std::endl << "end_header " << std::endl;
+
+    // rod vertex positions
+    size_t vtx = 0;
+    for( int rod_num = 0; rod_num < (int) vertexCounts.size(); ++rod_num )
+    {
+        for (int j = 0; j < vertexCounts[rod_num]; ++j, ++vtx)
         {
-            os << "f " << ( *f_itr ).idx[0] + 1 << " " << ( *f_itr ).idx[1] + 1 << " " << ( *f_itr ).idx[2] + 1 << std::endl;
+            os << vertices[vtx].x() << " " << vertices[vtx].y() << " " << vertices[vtx].z() << " " << rod_num <<std::endl;
         }
-        os.close();
     }
 }
 
+void SceneUtils::writeMesh( const std::string& fileName, const std::vector< Vec3 >& vertices, const std::vector< TriangularFace >& faces )
+{
+    std::ofstream os( fileName.c_str() );
+    // header
+    os << "# obj created by HairSim" << std::endl;
+    // vertices
+    for ( size_t v = 0; v < vertices.size(); ++v )
+    {
+        os << "v " << vertices[v].x() << " " << vertices[v].y() << " " << vertices[v].z() << std::endl;
+    }
+    // triangles
+    for(auto f_itr = faces.begin(); f_itr != faces.end(); ++ f_itr)
+    {
+        os << "f " << ( *f_itr ).idx[0] + 1 << " " << ( *f_itr ).idx[1] + 1 << " " << ( *f_itr ).idx[2] + 1 << std::endl;
+    }
+    os.close();
+}
+
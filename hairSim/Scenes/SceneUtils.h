@@ -5,10 +5,16 @@
 #include "../Mesh/TriMesh.h"
 #include "../Strand/ElasticStrand.h"
 
+class Scene;
+
 class SceneUtils
 {
 public:
       
+    // scenes
+    //! New scene of index \p problemIdx ( 1 to 8, as passed to --run ), NULL for an invalid index
+    static Scene* createScene( int problemIdx );
+
     // hair generation
     static void findOrthogonal( Vec3& v, const Vec3& u );
     static void genCurlyHair( const Vec3& initnorm, const Vec3& startpoint, const double& dL, 
@@ -27,6 +33,11 @@ public:
 
     // output
     static void dumpMesh( std::string outputdirectory, int current_frame, int file_width, const std::vector< TriMesh* >& meshes );
+    static std::string rodsFileName( const std::string& outputdirectory, int current_frame, int file_width );
+    static std::string meshFileName( const std::string& outputdirectory, int mesh_num, int current_frame, int file_width );
+    //! Writes the vertices of all the rods to a ply file, \p vertexCounts being the number of vertices of each rod
+    static void writeRods( const std::string& fileName, const std::vector< int >& vertexCounts, const std::vector< Vec3 >& vertices );
+    static void writeMesh( const std::string& fileName, const std::vector< Vec3 >& vertices, const std::vector< TriangularFace >& faces );
 
 protected:
 
@@ -118,7 +118,7 @@ void SingleContact::setupStrands()
     std::cout << "num strands = " << m_strands.size() <<'\n';
     std::cout << "num dofs per strand = " << nDOFs <<'\n';
     
-    GravitationForce::setGravity( GetVecOpt("gravity").cast<Scalar>() );
+    setGravity( GetVecOpt("gravity").cast<Scalar>() );
 }
 
 void SingleContact::setupMeshes()
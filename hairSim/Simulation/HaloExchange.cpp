@@ -0,0 +1,264 @@
+#include "HaloExchange.h"
+
+#include "../Strand/ElasticStrand.h"
+#include "../Strand/StrandDynamics.h"
+#include "../Strand/DOFScriptingController.h"
+#include "../Utils/Transport.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+HaloExchange::HaloExchange( Transport& transport, PartitionMode mode, Scalar haloWidth ):
+    m_transport( transport ),
+    m_mode( mode ),
+    m_haloWidth( haloWidth ),
+    m_numOwned( 0 )
+{}
+
+void HaloExchange::partition( std::vector< ElasticStrand* >& strands )
+{
+    const int numProcesses = m_transport.size();
+    const int rank = m_transport.rank();
+    const unsigned numStrands = strands.size();
+
+    // Point each strand is partitioned by
+    std::vector< Vec3 > points( numStrands );
+    Vec3 pointsMin = Vec3::Constant( std::numeric_limits< Scalar >::max() );
+    Vec3 pointsMax = -pointsMin;
+    Scalar totalVertices = 0.;
+    for( unsigned s = 0; s < numStrands; ++s )
+    {
+        const ElasticStrand* strand = strands[s];
+        Vec3 center = Vec3::Zero();
+        for( int v = 0; v < strand->getNumVertices(); ++v ){
+            center += strand->getVertex( v );
+        }
+        points[s] = m_mode == ROOT_PATCH ? strand->getVertex( 0 ) : Vec3( center / strand->getNumVertices() );
+        pointsMin = pointsMin.cwiseMin( points[s] );
+        pointsMax = pointsMax.cwiseMax( points[s] );
+        totalVertices += strand->getNumVertices();
+    }
+
+    // Slabs along the widest axis, with about the same number of vertices each
+    int axis;
+    ( pointsMax - pointsMin ).maxCoeff( &axis );
+    std::vector< std::pair< Scalar, unsigned > > order( numStrands );
+    for( unsigned s = 0; s < numStrands; ++s ){
+        order[s] = std::make_pair( points[s][axis], s );
+    }
+    std::sort( order.begin(), order.end() );
+
+    std::vector< int > owners( numStrands );
+    Scalar vertices = 0.;
+    for( unsigned k = 0; k < numStrands; ++k )
+    {
+        const unsigned s = order[k].second;
+        owners[s] = std::min( numProcesses - 1, ( int ) ( numProcesses * vertices / totalVertices ) );
+        vertices += strands[s]->getNumVertices();
+    }
+
+    m_strands.clear();
+    m_globalIds.clear();
+    m_ghosts.clear();
+    for( unsigned s = 0; s < numStrands; ++s )
+    {
+        if( owners[s] == rank )
+        {
+            m_strands.push_back( strands[s] );
+            m_globalIds.push_back( s );
+        }
+    }
+    m_numOwned = m_strands.size();
+    // Any strand may come into the halo later, all of them are kept
+    for( unsigned s = 0; s < numStrands; ++s )
+    {
+        if( owners[s] != rank )
+        {
+            m_ghosts[s] = m_strands.size();
+            m_strands.push_back( strands[s] );
+            m_globalIds.push_back( s );
+        }
+    }
+    m_active.assign( m_strands.size(), 0 );
+    std::fill( m_active.begin(), m_active.begin() + m_numOwned, 1 );
+
+    m_neighbours.clear();
+    for( int p = 0; p < numProcesses; ++p )
+    {
+        if( p != rank )
+        {
+            Neighbour neighbour;
+            neighbour.m_rank = p;
+            m_neighbours.push_back( neighbour );
+        }
+    }
+
+    // The simulation indexes its per-strand data by global index
+    for( unsigned i = 0; i < m_strands.size(); ++i ){
+        m_strands[i]->setGlobalIndex( i );
+    }
+
+    std::cout << "# Distributed: process " << rank << " owns " << m_numOwned << " of " << numStrands << " strands" << std::endl;
+
+    strands = m_strands;
+}
+
+static void boundingBox( const ElasticStrand& strand, Vec3& boxMin, Vec3& boxMax )
+{
+    boxMin = boxMax = strand.getVertex( 0 );
+    for( int v = 1; v < strand.getNumVertices(); ++v )
+    {
+        boxMin = boxMin.cwiseMin( strand.getVertex( v ) );
+        boxMax = boxMax.cwiseMax( strand.getVertex( v ) );
+    }
+}
+
+bool HaloExchange::sendReceive( int rank, const std::vector< char >& outgoing, std::vector< char >& incoming )
+{
+    if( m_transport.rank() < rank ){
+        return m_transport.send( rank, outgoing ) && m_transport.receive( rank, incoming );
+    }
+    return m_transport.receive( rank, incoming ) && m_transport.send( rank, outgoing );
+}
+
+bool HaloExchange::exchange()
+{
+    // Halos follow the strands: regions and the strands in them are recomputed from the current positions.
+    // Every process goes through its neighbours by increasing rank, so the pairs are served in the same order everywhere
+    std::vector< Vec3 > boxMin( m_numOwned ), boxMax( m_numOwned );
+    Vec3 regionMin = Vec3::Constant( std::numeric_limits< Scalar >::max() );
+    Vec3 regionMax = -regionMin;
+    for( unsigned i = 0; i < m_numOwned; ++i )
+    {
+        boundingBox( *m_strands[i], boxMin[i], boxMax[i] );
+        regionMin = regionMin.cwiseMin( boxMin[i] );
+        regionMax = regionMax.cwiseMax( boxMax[i] );
+    }
+
+    std::vector< char > outgoing( 6 * sizeof( Scalar ) ), incoming;
+    std::memcpy( &outgoing[0], regionMin.data(), 3 * sizeof( Scalar ) );
+    std::memcpy( &outgoing[3 * sizeof( Scalar )], regionMax.data(), 3 * sizeof( Scalar ) );
+    for( unsigned n = 0; n < m_neighbours.size(); ++n )
+    {
+        Neighbour& neighbour = m_neighbours[n];
+        if( !sendReceive( neighbour.m_rank, outgoing, incoming ) ){
+            return false;
+        }
+        if( incoming.size() != outgoing.size() )
+        {
+            std::cerr << "HaloExchange: unexpected region from process " << neighbour.m_rank << std::endl;
+            return false;
+        }
+        std::memcpy( neighbour.m_regionMin.data(), &incoming[0], 3 * sizeof( Scalar ) );
+        std::memcpy( neighbour.m_regionMax.data(), &incoming[3 * sizeof( Scalar )], 3 * sizeof( Scalar ) );
+    }
+
+    std::fill( m_active.begin() + m_numOwned, m_active.end(), 0 );
+    std::vector< unsigned > sent;
+    for( unsigned n = 0; n < m_neighbours.size(); ++n )
+    {
+        const Neighbour& neighbour = m_neighbours[n];
+        sent.clear();
+        for( unsigned i = 0; i < m_numOwned; ++i )
+        {
+            if( ( ( boxMin[i].array() - m_haloWidth ) <= neighbour.m_regionMax.array() ).all()
+                && ( ( boxMax[i].array() + m_haloWidth ) >= neighbour.m_regionMin.array() ).all() ){
+                sent.push_back( i );
+            }
+        }
+        write( sent, outgoing );
+        if( !sendReceive( neighbour.m_rank, outgoing, incoming ) || !read( incoming ) ){
+            return false;
+        }
+    }
+    return true;
+}
+
+template< typename T >
+static void append( std::vector< char >& message, const T* data, size_t count )
+{
+    const size_t offset = message.size();
+    message.resize( offset + count * sizeof( T ) );
+    std::memcpy( &message[offset], data, count * sizeof( T ) );
+}
+
+// Message: number of strands, then for each one its global index, its number of dofs,
+// its current dofs and the displacement of its last step
+void HaloExchange::write( const std::vector< unsigned >& sent, std::vector< char >& message ) const
+{
+    message.clear();
+    const int count = sent.size();
+    append( message, &count, 1 );
+    for( unsigned k = 0; k < sent.size(); ++k )
+    {
+        const unsigned i = sent[k];
+        const ElasticStrand* strand = m_strands[i];
+        const VecXx& dofs = strand->getCurrentDegreesOfFreedom();
+        const VecXx displacements = strand->dynamics().getCurrentVelocities();
+        const int numDofs = dofs.size();
+
+        append( message, &m_globalIds[i], 1 );
+        append( message, &numDofs, 1 );
+        append( message, dofs.data(), numDofs );
+        append( message, displacements.data(), numDofs );
+    }
+}
+
+bool HaloExchange::read( const std::vector< char >& message )
+{
+    const char* data = message.data();
+    const char* const end = data + message.size();
+    auto extract = [&]( void* dest, size_t size ) {
+        if( data + size > end ){
+            return false;
+        }
+        std::memcpy( dest, data, size );
+        data += size;
+        return true;
+    };
+
+    int count = 0;
+    if( !extract( &count, sizeof( count ) ) ){
+        return false;
+    }
+    VecXx dofs, displacements;
+    for( int k = 0; k < count; ++k )
+    {
+        int globalId = 0, numDofs = 0;
+        if( !extract( &globalId, sizeof( globalId ) ) || !extract( &numDofs, sizeof( numDofs ) ) ){
+            return false;
+        }
+        dofs.resize( numDofs );
+        displacements.resize( numDofs );
+        if( !extract( dofs.data(), numDofs * sizeof( Scalar ) ) || !extract( displacements.data(), numDofs * sizeof( Scalar ) ) ){
+            return false;
+        }
+
+        const std::map< int, unsigned >::const_iterator ghost = m_ghosts.find( globalId );
+        if( ghost == m_ghosts.end() || m_strands[ ghost->second ]->getCurrentDegreesOfFreedom().size() != numDofs )
+        {
+            std::cerr << "HaloExchange: unexpected strand " << globalId << " from another process" << std::endl;
+            return false;
+        }
+
+        // The ghost restarts from its owner's state and repeats its owner's last displacement
+        m_active[ ghost->second ] = 1;
+        ElasticStrand* strand = m_strands[ ghost->second ];
+        strand->setCurrentDegreesOfFreedom( dofs );
+        strand->setFutureDegreesOfFreedom( dofs );
+        strand->dynamics().invalidatePhysics();
+
+        DOFScriptingController* controller = strand->dynamics().getScriptingController();
+        controller->clear();
+        for( int v = 0; v < strand->getNumVertices(); ++v )
+        {
+            controller->setVertexDisplacement( v, displacements.segment< 3 >( 4 * v ) );
+            if( v + 1 < strand->getNumVertices() ){
+                controller->setThetaDisplacement( v, displacements[ 4 * v + 3 ] );
+            }
+        }
+    }
+    return data == end;
+}
@@ -0,0 +1,78 @@
+#ifndef HALOEXCHANGE_H_
+#define HALOEXCHANGE_H_
+
+#include "../Utils/Definitions.h"
+
+#include <map>
+#include <vector>
+
+class ElasticStrand;
+class Transport;
+
+/* [H]
+    Splits the strands of a scene between the processes of a distributed simulation.
+    Every process builds the whole scene, and keeps the strands it owns followed by
+    ghost copies of all the others.
+    Before every step, processes exchange the bounding boxes of the strands they own,
+    then owners send the state of their strands that come within haloWidth of another
+    process's region to that process. The ghosts received are active for the step:
+    they are fully scripted to follow the motion of their owner's last step, and
+    collisions with them are detected and solved like any other, but only move the owned
+    strand, each process moving its own side. Other ghosts are left out of the step,
+    see Simulation::setActiveStrands().
+*/
+
+class HaloExchange
+{
+public:
+    enum PartitionMode
+    {
+        ROOT_PATCH = 0, //!< Strands are split by the positions of their roots
+        SPATIAL_REGION = 1 //!< Strands are split by the positions of their centers
+    };
+
+    HaloExchange( Transport& transport, PartitionMode mode, Scalar haloWidth );
+
+    //! Replaces \p strands with the strands owned by this process, followed by its ghosts; deletes the others
+    void partition( std::vector< ElasticStrand* >& strands );
+
+    //! Number of strands stepped by this process, which come first in the partitioned strands
+    unsigned numOwned() const
+    { return m_numOwned; }
+
+    //! Sends the state of the owned strands to the processes whose halo they are in, and moves the local ghosts in the halo
+    /*! \return false if another process is gone */
+    bool exchange();
+
+    //! Whether each partitioned strand takes part in the next step: the owned ones and the ghosts received by the last exchange()
+    const std::vector< char >& activeStrands() const
+    { return m_active; }
+
+private:
+    struct Neighbour
+    {
+        int m_rank;
+        Vec3 m_regionMin; //!< Bounding box of its strands at the last exchange()
+        Vec3 m_regionMax;
+    };
+
+    //! Lower rank of each pair first, so that two processes never both wait on a send
+    bool sendReceive( int rank, const std::vector< char >& outgoing, std::vector< char >& incoming );
+
+    void write( const std::vector< unsigned >& sent, std::vector< char >& message ) const;
+    bool read( const std::vector< char >& message );
+
+    Transport& m_transport;
+    PartitionMode m_mode;
+    Scalar m_haloWidth;
+
+    std::vector< ElasticStrand* > m_strands; //!< Owned strands, then ghosts
+    std::vector< int > m_globalIds; //!< Index of each strand in the scene
+    std::map< int, unsigned > m_ghosts; //!< Local index of the ghost of each global index
+    unsigned m_numOwned;
+    std::vector< char > m_active;
+
+    std::vector< Neighbour > m_neighbours; //!< All other processes, by increasing rank
+};
+
+#endif /* HALOEXCHANGE_H_ */
@@ -10,6 +10,7 @@
 #include "../Forces/ForceAccumulator.hh"
 #include "../Collision/TwistEdgeHandler.h"
 #include "../Forces/NonLinearForce.h"
+#include "../Utils/Profiler.h"
 
 /*
 TODO: this file/code is a long way from that,
@@ -51,6 +52,7 @@ ImplicitStepper::ImplicitStepper( ElasticStrand& strand, const SimulationParamet
     m_params( params ),
     m_notSPD( false ), 
     m_usedNonlinearSolver( false ),
+    m_lastStretchRatio( 0. ),
     m_strand( strand ), //
     m_dt( 0. ),
     m_nonlinearCallback( NULL ),
@@ -116,6 +118,7 @@ void ImplicitStepper::prepareDynamics()
 
 void ImplicitStepper::solveNonLinear()
 {
+    PROFILE_SCOPE( "solveNonLinear" );
     StrandDynamics& dynamics = m_strand.dynamics() ;
 
     Scalar minErr = 1.e99, prevErr = 1.e99;
@@ -199,6 +202,7 @@ void ImplicitStepper::solveNonLinear()
 
 void ImplicitStepper::solveLinear()
 {
+    PROFILE_SCOPE( "solveLinear" );
     computeRHS();
     computeLHS();
 
@@ -267,6 +271,7 @@ bool ImplicitStepper::update( bool afterConstraints )
 
     // DK: failsafes here:
     const Scalar stretchE = getLineicStretch();
+    m_lastStretchRatio = stretchE / m_stretchingFailureThreshold;
     if( stretchE > m_stretchingFailureThreshold )
     {
         //  Don't bother with very small strands, they would create numerical problems anyway
@@ -77,9 +77,17 @@ public:
     bool lastStepWasRejected() const
     { return m_lastStepWasRejected; }
 
+    //! Lineic stretch at the last update(), relative to the failure threshold ( rejected above 1 )
+    Scalar lastStretchRatio() const
+    { return m_lastStretchRatio; }
+
     bool usedNonLinearSolver()
     { return m_usedNonlinearSolver; }
 
+    //! Iterations of the last solveNonLinear()
+    unsigned newtonIterations() const
+    { return m_newtonIter; }
+
     bool refusesMutualContacts() const
     { return notSPD(); }
 
@@ -124,6 +132,7 @@ private:
     bool m_notSPD;
     bool m_usedNonlinearSolver;
     bool m_lastStepWasRejected;
+    Scalar m_lastStretchRatio;
 
     VecXx m_rhs;
     VecXx m_impulseRhs; // for zeroth-order contact 
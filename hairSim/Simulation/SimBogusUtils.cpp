@@ -1,5 +1,24 @@
 #include "Simulation.h"
 #include "ImplicitStepper.h"
+#include "../Utils/Profiler.h"
+
+#include <omp.h>
+
+static ImpulseCache::key_type impulseKey( const CollidingPair& collision )
+{
+    return std::make_pair( std::make_pair( collision.objects.first.globalIndex, collision.objects.first.vertex ),
+                           std::make_pair( collision.objects.second.globalIndex, collision.objects.second.vertex ) );
+}
+
+static ImpulseCache::value_type cachedImpulse( const CollidingPair& collision, const Vec3& impulse )
+{
+    CachedImpulse cached;
+    cached.abscissae[0] = collision.objects.first.abscissa;
+    cached.abscissae[1] = collision.objects.second.abscissa;
+    cached.normal = collision.m_normal;
+    cached.impulse = impulse;
+    return std::make_pair( impulseKey( collision ), cached );
+}
 
 bool Simulation::assembleBogusFrictionProblem( 
         CollidingGroup& collisionGroup,
@@ -8,10 +27,15 @@ bool Simulation::assembleBogusFrictionProblem(
         VecXx& vels, 
         VecXx& impulses,
         VecXu& startDofs, 
-        VecXu& nDofs )
+        VecXu& nDofs,
+        const CollidingPairs* interfaceContacts )
 {
+    PROFILE_SCOPE( "bogus assembly" );
 
     unsigned nContacts = collisionGroup.second.size();
+    if( interfaceContacts ){
+        nContacts += interfaceContacts->size();
+    }
 
     std::vector<unsigned> nndofs;
     unsigned nSubsystems = collisionGroup.first.size(); 
@@ -45,104 +69,94 @@ bool Simulation::assembleBogusFrictionProblem(
         return false; // needs to be false to break out of solvecollidinggroup if statement
     }
 
-    // Prepare the steppers
-#pragma omp parallel for
-    for ( unsigned i = 0; i < globalIds.size(); ++i )
-    { // make sure steppers are ready for us to read their info/members... solve if not yet solved, reset where necessary
-        m_steppers[ globalIds[i] ]->prepareForExternalSolve();
-    }
-
-    std::vector < SymmetricBandMatrixSolver<double, 10>* > MassMat;
-    MassMat.resize( nSubsystems );
-
-    VecXx forces( dofCount );
-
     vels.resize( dofCount );
     impulses.resize( nContacts * 3 );
     impulses.setZero();
 
-    VecXx mu( nContacts );
-
-    std::vector < Eigen::Matrix< double, 3, 3 > > E; E.resize( nContacts );
+    // Blocks are written directly into the problem, from the steppers and deformation gradients
+    mecheProblem.beginPrimal( nndofs, nContacts, dofIndices );
 
-    VecXx u_frees( nContacts * 3 );
-    u_frees.setZero();
-
-    int ObjA[ nContacts ];
-    int ObjB[ nContacts ];
+    // Prepare the steppers and set up objects
+#pragma omp parallel for
+    for ( unsigned i = 0; i < globalIds.size(); ++i )
+    { // make sure steppers are ready for us to read their info/members... solve if not yet solved, reset where necessary
+        ImplicitStepper& stepper = *m_steppers[ globalIds[i] ];
+        stepper.prepareForExternalSolve();
 
-    std::vector < SparseRowMatx* > H_0; H_0.resize( nContacts );
-    std::vector < SparseRowMatx* > H_1; H_1.resize( nContacts );
+        mecheProblem.setObject( i, stepper.linearSolver(), 
+                m_params.m_alwaysUseNonLinear ? -stepper.rhs() : -stepper.impulse_rhs() );
+    }
 
-    unsigned objectId = 0, collisionId = 0, currDof = 0;
+    unsigned collisionId = 0;
+    unsigned nWarmStarted = 0;
 
-    // Setting up objects and adding external constraints
+    // Adding external constraints
     for ( IndicesMap::const_iterator it = collisionGroup.first.begin(); it != collisionGroup.first.end(); ++it )
     {
-        const unsigned sIdx = it->first;
-        ImplicitStepper& stepper = *m_steppers[sIdx];
-
-        JacobianSolver *M = &stepper.linearSolver();
-        MassMat[ objectId++ ] = M;
-
-        if( m_params.m_alwaysUseNonLinear )
-        {
-            forces.segment( currDof, stepper.rhs().size() ) = -stepper.rhs();
-            currDof += stepper.rhs().size();
-        }
-        else
-        {
-            forces.segment( currDof, stepper.impulse_rhs().size() ) = -stepper.impulse_rhs();
-            currDof += stepper.impulse_rhs().size();
-        }
-
-        CollidingPairs & externalCollisions = m_externalContacts[sIdx];
+        CollidingPairs & externalCollisions = m_externalContacts[ it->first ];
         for ( unsigned i = 0; i < externalCollisions.size(); ++i, ++collisionId )
         {
             CollidingPair& c = externalCollisions[i];
 
-            mu[ collisionId ] = c.m_mu;
-            E [ collisionId ] = c.m_transformationMatrix;
-            // u_frees.segment<3>( ( collisionId ) * 3 ) = c.objects.first.freeVel - c.objects.second.freeVel;
-            ObjA[ collisionId ] = (int) it->second;
-            ObjB[ collisionId ] = -1;
-            H_0 [ collisionId ] = c.objects.first.defGrad;
-            H_1 [ collisionId ] = NULL;
+            mecheProblem.setContact( collisionId, c.m_mu, c.m_transformationMatrix, 
+                    (int) it->second, -1, &c.objects.first.defGrad, NULL );
+
+            Vec3 r;
+            if( m_params.m_warmStartImpulses && warmStartImpulse( c, r ) )
+            {
+                impulses.segment<3>( 3 * collisionId ) = r;
+                ++nWarmStarted;
+            }
         }
     }
 
     // Setting up RodRod constraints
-#pragma omp parallel for
+#pragma omp parallel for reduction( + : nWarmStarted )
     for ( unsigned i = 0; i < collisionGroup.second.size(); ++i )
     {
         CollidingPair& collision = collisionGroup.second[i];
         const int oId1 = collisionGroup.first.find( collision.objects.first.globalIndex )->second;
         const int oId2 = collisionGroup.first.find( collision.objects.second.globalIndex )->second;
 
-        mu[ collisionId + i ] = collision.m_mu;
-        E [ collisionId + i ] = collision.m_transformationMatrix;
-        // u_frees.segment<3>( ( collisionId + i ) * 3 ) = collision.objects.first.freeVel - collision.objects.second.freeVel;
-        ObjA[ collisionId + i ] = oId1;
-        ObjB[ collisionId + i ] = oId2;
-        H_0 [ collisionId + i ] = collision.objects.first.defGrad;
-        H_1 [ collisionId + i ] = collision.objects.second.defGrad;
+        mecheProblem.setContact( collisionId + i, collision.m_mu, collision.m_transformationMatrix, 
+                oId1, oId2, &collision.objects.first.defGrad, &collision.objects.second.defGrad );
+
+        Vec3 r;
+        if( m_params.m_warmStartImpulses && warmStartImpulse( collision, r ) )
+        {
+            impulses.segment<3>( 3 * ( collisionId + i ) ) = r;
+            ++nWarmStarted;
+        }
+    }
+
+    // Contacts with strands outside of the group, whose velocities are accounted for in w
+    if( interfaceContacts )
+    {
+        const unsigned interfaceId = collisionId + collisionGroup.second.size();
+#pragma omp parallel for reduction( + : nWarmStarted )
+        for ( unsigned i = 0; i < interfaceContacts->size(); ++i )
+        {
+            const CollidingPair& collision = (*interfaceContacts)[i];
+            const int oId = collisionGroup.first.find( collision.objects.first.globalIndex )->second;
+
+            mecheProblem.setContact( interfaceId + i, collision.m_mu, collision.m_transformationMatrix, 
+                    oId, -1, &collision.objects.first.defGrad, NULL );
+
+            Vec3 r;
+            if( m_params.m_warmStartImpulses && warmStartImpulse( collision, r ) )
+            {
+                impulses.segment<3>( 3 * ( interfaceId + i ) ) = r;
+                ++nWarmStarted;
+            }
+        }
     }
-    assert( collisionId + collisionGroup.second.size() == nContacts );
-
-    mecheProblem.fromPrimal( 
-                    nSubsystems,
-                    nndofs,
-                    MassMat, 
-                    forces,
-                    nContacts, 
-                    mu, 
-                    E, 
-                    u_frees, // this is what we want the velocity to be given resting contact, set it to zero?
-                    ObjA, 
-                    ObjB, 
-                    H_0, 
-                    H_1,
-                    dofIndices );
+    assert( collisionId + collisionGroup.second.size() + ( interfaceContacts ? interfaceContacts->size() : 0 ) == nContacts );
+
+    m_metrics.add( SimulationMetrics::FRICTION_CONTACTS, nContacts );
+    m_metrics.add( SimulationMetrics::WARM_STARTED_CONTACTS, nWarmStarted );
+
+    // Free velocities are left to zero
+    mecheProblem.finalizePrimal();
 
     return true;
 }
@@ -155,6 +169,7 @@ bool Simulation::solveBogusFrictionProblem(
         VecXx& vels, 
         VecXx& impulses )
 {
+    PROFILE_SCOPE( "bogus solve" );
     if( nonLinear )
     {
         for ( unsigned i = 0; i < globalIds.size(); ++i )
@@ -163,19 +178,39 @@ bool Simulation::solveBogusFrictionProblem(
         }
     }
 
-    const double residual = mecheProblem.solve( 
+    const bool warmStarted = !impulses.isZero();
+
+    // Large groups are solved by their own team of threads, see Simulation::step_solveCollisions();
+    // coloring keeps the multithreaded GS deterministic. Others run a plain sequential GS
+    const unsigned nContacts = mecheProblem.nContacts();
+    const bool useColoring = m_params.m_coloredGSContactThreshold > 0 && nContacts >= m_params.m_coloredGSContactThreshold
+                             && omp_get_max_threads() > 1;
+
+    // Very large groups would fill a huge Delassus operator, W is only applied through the strands' factorizations
+    const bool matrixFree = m_params.m_matrixFreeContactThreshold > 0 && nContacts >= m_params.m_matrixFreeContactThreshold;
+
+    const double residual = matrixFree ?
+                            mecheProblem.solveMatrixFree( impulses, vels, 0.0, 0, false ) :
+                            mecheProblem.solve( 
                             impulses,   // impulse guess and returned impulse
                             vels,       // returned velocities
-                            0,     // max number of threads, else OpenMP default
+                            useColoring ? omp_get_max_threads() : 1,     // max number of threads, > 1 enables coloring
                             0.0,   // tolerance
                             0,     // max iterations
                             false, // static problem
                             0.0,   // regularization
                             false, // use infinity norm
-                            false, // use projected gradient
-                            0 ); // cadoux iters
+                            m_params.m_useProjectedGradient, // use projected gradient
+                            m_params.m_useProjectedGradient ? std::max( 1u, m_params.m_cadouxIterations ) : 0 ); // cadoux iters, APGD needs at least one
 
-    bool failed = residual > std::sqrt( m_params.m_gaussSeidelTolerance ); // arbitrary tolerance
+    m_metrics.sample( SimulationMetrics::GS_ITERATIONS, mecheProblem.lastSolveIterations() );
+    m_metrics.sample( warmStarted ? SimulationMetrics::WARM_GS_ITERATIONS : SimulationMetrics::COLD_GS_ITERATIONS,
+                      mecheProblem.lastSolveIterations() );
+    m_metrics.sample( SimulationMetrics::GS_RESIDUAL, residual );
+    m_metrics.sample( SimulationMetrics::FRICTION_SOLVE_TIME, mecheProblem.lastSolveTime() );
+
+    // A negative residual means that the problem could not be solved
+    bool failed = residual < 0. || residual > std::sqrt( m_params.m_gaussSeidelTolerance ); // arbitrary tolerance
     if( failed ){
         std::cerr << "GS did not converge [ err=" << residual << ", numContacts=" << impulses.size() / 3 << " ] " << std::endl;
     }
@@ -193,6 +228,7 @@ void Simulation::postProcessBogusFrictionProblem(
         VecXu& startDofs, 
         VecXu& nDofs )
 {
+    PROFILE_SCOPE( "bogus post-process" );
     if( accept )
     {
         assert( globalIds.size() == (unsigned) startDofs.size() );
@@ -201,6 +237,10 @@ void Simulation::postProcessBogusFrictionProblem(
         m_globalIds.clear();
         m_globalIds = globalIds;
 
+        if( m_params.m_warmStartImpulses ){
+            cacheImpulses( collisionGroup, impulses );
+        }
+
 #pragma omp parallel for
         for( unsigned i = 0; i < globalIds.size(); ++i )
         {
@@ -213,3 +253,57 @@ void Simulation::postProcessBogusFrictionProblem(
     }
 }
 
+
+bool Simulation::warmStartImpulse( const CollidingPair& collision, Vec3& impulse ) const
+{
+    typedef std::pair< ImpulseCache::const_iterator, ImpulseCache::const_iterator > Range;
+    const Range range = m_previousImpulses.equal_range( impulseKey( collision ) );
+
+    // Same strands and edges; pick the closest abscissae within tolerance
+    ImpulseCache::const_iterator best = range.second;
+    Scalar bestDrift = m_params.m_warmStartAbscissaTolerance;
+    for( ImpulseCache::const_iterator it = range.first; it != range.second; ++it )
+    {
+        const Scalar drift = std::max( std::fabs( it->second.abscissae[0] - collision.objects.first.abscissa ),
+                                       std::fabs( it->second.abscissae[1] - collision.objects.second.abscissa ) );
+        if( drift <= bestDrift )
+        {
+            bestDrift = drift;
+            best = it;
+        }
+    }
+    if( best == range.second ){
+        return false;
+    }
+
+    // Rotate the old impulse along with the contact normal, so that its normal and
+    // tangential magnitudes ( hence its position wrt. the friction cone ) are preserved
+    const Eigen::Quaternion<Scalar> rotation = Eigen::Quaternion<Scalar>::FromTwoVectors( best->second.normal, collision.m_normal );
+    impulse = rotation * best->second.impulse;
+    return true;
+}
+
+void Simulation::cacheImpulses( const CollidingGroup& collisionGroup, const VecXx& impulses )
+{
+    std::vector< ImpulseCache::value_type > solved;
+    solved.reserve( impulses.size() / 3 );
+
+    unsigned collisionId = 0;
+    for ( IndicesMap::const_iterator it = collisionGroup.first.begin(); it != collisionGroup.first.end(); ++it )
+    {
+        const CollidingPairs& externalCollisions = m_externalContacts[ it->first ];
+        for ( unsigned i = 0; i < externalCollisions.size(); ++i, ++collisionId )
+        {
+            solved.push_back( cachedImpulse( externalCollisions[i], impulses.segment<3>( 3 * collisionId ) ) );
+        }
+    }
+    for ( unsigned i = 0; i < collisionGroup.second.size(); ++i, ++collisionId )
+    {
+        solved.push_back( cachedImpulse( collisionGroup.second[i], impulses.segment<3>( 3 * collisionId ) ) );
+    }
+
+#pragma omp critical (impulseCache)
+    {
+        m_currentImpulses.insert( solved.begin(), solved.end() );
+    }
+}
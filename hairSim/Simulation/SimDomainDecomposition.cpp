@@ -0,0 +1,395 @@
+#include "Simulation.h"
+#include "ImplicitStepper.h"
+#include "../Utils/Profiler.h"
+
+#include <omp.h>
+#include <algorithm>
+#include <set>
+
+/* [H]
+    Domain decomposition of large colliding groups.
+    The strands of a group are split into subdomains, each solved as its own friction problem.
+    A contact between two subdomains belongs to the subdomain of its first strand, where it is
+    an external contact whose free velocity comes from the (frozen) second strand; in turn,
+    its impulse is a constant force on the second strand's subdomain.
+    Subdomains are colored so that neighbours are never solved at the same time; sweeping
+    over the colors is then a block Gauss-Seidel, repeated until the interface contacts
+    satisfy the Coulomb law.
+*/
+
+namespace
+{
+
+//! Part of a colliding group, solved as a single friction problem
+struct Subdomain
+{
+    Subdomain():
+        accepted( false )
+    {}
+
+    CollidingGroup group;                  //!< Strands and the mutual contacts between them
+    CollidingPairs interface;              //!< Contacts with other subdomains whose first strand is in this one
+    std::vector<unsigned> mutualIds;       //!< Index of each contact of group.second in the whole group's mutual contacts
+    std::vector<unsigned> interfaceIds;    //!< Same for interface
+    std::vector<unsigned> incomingIds;     //!< Mutual contacts of other subdomains acting on the strands of this one
+    std::vector<unsigned> contactIds;      //!< Index in the whole group of each contact of the problem
+
+    bogus::MecheFrictionProblem problem;
+    std::vector<unsigned> globalIds;
+    VecXx vels;
+    VecXx impulses;
+    VecXu startDofs;
+    VecXu nDofs;
+    bool accepted;
+};
+
+//! Appends to \p order the strands reachable from \p start, then from the remaining unvisited ones
+void breadthFirstOrder( const std::vector< std::vector<unsigned> >& neighbours, unsigned start, std::vector<unsigned>& order )
+{
+    const unsigned nStrands = neighbours.size();
+    std::vector<char> visited( nStrands, 0 );
+    order.clear();
+    order.reserve( nStrands );
+
+    for( unsigned s = 0; s <= nStrands; ++s )
+    {
+        const unsigned root = s ? s - 1 : start;
+        if( visited[root] ){
+            continue;
+        }
+        visited[root] = 1;
+        order.push_back( root );
+
+        for( unsigned k = order.size() - 1; k < order.size(); ++k )
+        {
+            const std::vector<unsigned>& next = neighbours[ order[k] ];
+            for( unsigned n = 0; n < next.size(); ++n )
+            {
+                if( !visited[ next[n] ] ){
+                    visited[ next[n] ] = 1;
+                    order.push_back( next[n] );
+                }
+            }
+        }
+    }
+}
+
+//! Natural map residual of the Coulomb law with De Saxce's change of variable, in local coordinates
+Scalar coulombResidual( const Vec3& u, const Vec3& r, Scalar mu )
+{
+    Vec3 x = r - u;
+    x[0] -= mu * u.tail<2>().norm();
+
+    // Projection of x on the friction cone
+    const Scalar xT = x.tail<2>().norm();
+    Vec3 proj;
+    if( xT <= mu * x[0] ){
+        proj = x;
+    } else if( mu * xT <= -x[0] ){
+        proj.setZero();
+    } else {
+        const Scalar alpha = ( mu * xT + x[0] ) / ( 1. + mu * mu );
+        proj[0] = alpha;
+        proj.tail<2>() = ( mu * alpha / xT ) * x.tail<2>();
+    }
+    return ( r - proj ).norm();
+}
+
+}
+
+bool Simulation::useDomainDecomposition( const CollidingGroup &cg ) const
+{
+    return m_params.m_domainDecompositionMinStrands > 0 && cg.first.size() >= m_params.m_domainDecompositionMinStrands;
+}
+
+unsigned Simulation::partitionCollidingGroup( const CollidingGroup &cg, unsigned nDomains, std::vector<unsigned> &domains ) const
+{
+    const IndicesMap& indices = cg.first;
+    const unsigned nStrands = indices.size();
+
+    // Strand graph, weighted by the number of contacts on each strand
+    std::vector< std::vector<unsigned> > neighbours( nStrands );
+    std::vector<unsigned> weights( nStrands, 1 );
+    for( IndicesMap::const_iterator it = indices.begin(); it != indices.end(); ++it )
+    {
+        weights[ it->second ] += m_externalContacts[ it->first ].size();
+    }
+    for( unsigned i = 0; i < cg.second.size(); ++i )
+    {
+        const unsigned a = indices.find( cg.second[i].objects.first.globalIndex )->second;
+        const unsigned b = indices.find( cg.second[i].objects.second.globalIndex )->second;
+        neighbours[a].push_back( b );
+        neighbours[b].push_back( a );
+        ++weights[a];
+        ++weights[b];
+    }
+
+    // Consecutive strands of a breadth-first ordering are close in the graph, so cutting it into
+    // chunks of equal weight gives compact subdomains. Starting from the last strand of
+    // a first traversal ( a pseudo-peripheral one ) makes the chunks thinner
+    std::vector<unsigned> order;
+    breadthFirstOrder( neighbours, 0, order );
+    breadthFirstOrder( neighbours, order.back(), order );
+
+    unsigned long totalWeight = 0;
+    for( unsigned s = 0; s < nStrands; ++s ){
+        totalWeight += weights[s];
+    }
+
+    domains.resize( nStrands );
+    unsigned long weight = 0;
+    for( unsigned k = 0; k < nStrands; ++k )
+    {
+        domains[ order[k] ] = std::min<unsigned long>( nDomains - 1, weight * nDomains / totalWeight );
+        weight += weights[ order[k] ];
+    }
+
+    // A subdomain that owns no contact would only receive forces from its neighbours;
+    // merge it into the subdomain owning one of its contacts
+    std::vector<unsigned> owned( nDomains, 0 );
+    for( IndicesMap::const_iterator it = indices.begin(); it != indices.end(); ++it )
+    {
+        owned[ domains[ it->second ] ] += m_externalContacts[ it->first ].size();
+    }
+    for( unsigned i = 0; i < cg.second.size(); ++i )
+    {
+        ++owned[ domains[ indices.find( cg.second[i].objects.first.globalIndex )->second ] ];
+    }
+    for( unsigned i = 0; i < cg.second.size(); ++i )
+    {
+        const unsigned a = domains[ indices.find( cg.second[i].objects.first.globalIndex )->second ];
+        const unsigned b = domains[ indices.find( cg.second[i].objects.second.globalIndex )->second ];
+        if( owned[b] == 0 )
+        {
+            std::replace( domains.begin(), domains.end(), b, a );
+            owned[b] = owned[a];
+        }
+    }
+
+    // Contiguous numbering of the remaining subdomains
+    std::vector<int> renumbering( nDomains, -1 );
+    unsigned nUsed = 0;
+    for( unsigned s = 0; s < nStrands; ++s )
+    {
+        if( renumbering[ domains[s] ] == -1 ){
+            renumbering[ domains[s] ] = nUsed++;
+        }
+        domains[s] = renumbering[ domains[s] ];
+    }
+    return nUsed;
+}
+
+bool Simulation::solveByDomainDecomposition( CollidingGroup &collisionGroup, bool asFailSafe, bool nonLinear,
+        std::vector<unsigned> &globalIds, VecXx& vels, VecXx& impulses, VecXu& startDofs, VecXu& nDofs )
+{
+    PROFILE_SCOPE( "domain decomposition" );
+    const IndicesMap& indices = collisionGroup.first;
+    const CollidingPairs& mutualContacts = collisionGroup.second;
+    const unsigned nStrands = indices.size();
+
+    // Layout of the whole group, as in assembleBogusFrictionProblem()
+    globalIds.clear();
+    globalIds.reserve( nStrands );
+    startDofs.resize( nStrands );
+    nDofs.resize( nStrands );
+    std::vector<unsigned> externalOffsets( nStrands );
+
+    unsigned dofCount = 0;
+    unsigned nExternal = 0;
+    for( IndicesMap::const_iterator it = indices.begin(); it != indices.end(); ++it )
+    {
+        const unsigned k = it->second;
+        globalIds.push_back( it->first );
+        startDofs[k] = dofCount;
+        nDofs[k] = m_steppers[ it->first ]->m_futureVelocities.rows();
+        externalOffsets[k] = nExternal;
+        dofCount += nDofs[k];
+        nExternal += m_externalContacts[ it->first ].size();
+    }
+    vels.setZero( dofCount );
+    impulses.setZero( 3 * ( nExternal + mutualContacts.size() ) );
+
+    const unsigned maxDomains = m_params.m_domainDecompositionSubdomains > 0 ?
+        m_params.m_domainDecompositionSubdomains : 2 * omp_get_max_threads();
+
+    std::vector<unsigned> domainOf;
+    const unsigned nDomains = partitionCollidingGroup( collisionGroup, std::min( maxDomains, nStrands ), domainOf );
+
+    std::vector< Subdomain* > domains( nDomains );
+    for( unsigned d = 0; d < nDomains; ++d ){
+        domains[d] = new Subdomain;
+    }
+    for( IndicesMap::const_iterator it = indices.begin(); it != indices.end(); ++it )
+    {
+        domains[ domainOf[ it->second ] ]->group.first[ it->first ] = 0;
+    }
+
+    std::vector< std::set<unsigned> > adjacentDomains( nDomains );
+    for( unsigned i = 0; i < mutualContacts.size(); ++i )
+    {
+        const CollidingPair& collision = mutualContacts[i];
+        const unsigned a = domainOf[ indices.find( collision.objects.first.globalIndex )->second ];
+        const unsigned b = domainOf[ indices.find( collision.objects.second.globalIndex )->second ];
+        if( a == b )
+        {
+            domains[a]->group.second.push_back( collision );
+            domains[a]->mutualIds.push_back( i );
+        }
+        else
+        {
+            domains[a]->interface.push_back( collision );
+            domains[a]->interfaceIds.push_back( i );
+            domains[b]->incomingIds.push_back( i );
+            adjacentDomains[a].insert( b );
+            adjacentDomains[b].insert( a );
+        }
+    }
+
+    // Same contact order as assembleBogusFrictionProblem()
+    for( unsigned d = 0; d < nDomains; ++d )
+    {
+        Subdomain& sub = *domains[d];
+        unsigned k = 0;
+        for( IndicesMap::iterator it = sub.group.first.begin(); it != sub.group.first.end(); ++it )
+        {
+            it->second = k++;
+
+            const unsigned offset = externalOffsets[ indices.find( it->first )->second ];
+            for( unsigned i = 0; i < m_externalContacts[ it->first ].size(); ++i ){
+                sub.contactIds.push_back( offset + i );
+            }
+        }
+        for( unsigned i = 0; i < sub.mutualIds.size(); ++i ){
+            sub.contactIds.push_back( nExternal + sub.mutualIds[i] );
+        }
+        for( unsigned i = 0; i < sub.interfaceIds.size(); ++i ){
+            sub.contactIds.push_back( nExternal + sub.interfaceIds[i] );
+        }
+    }
+
+    // Adjacent subdomains get different colors, subdomains of the same color are solved in parallel
+    std::vector< std::vector<unsigned> > colors;
+    std::vector<int> colorOf( nDomains, -1 );
+    for( unsigned d = 0; d < nDomains; ++d )
+    {
+        std::vector<char> used( colors.size() + 1, 0 );
+        for( std::set<unsigned>::const_iterator n = adjacentDomains[d].begin(); n != adjacentDomains[d].end(); ++n )
+        {
+            if( colorOf[*n] != -1 ){
+                used[ colorOf[*n] ] = 1;
+            }
+        }
+        colorOf[d] = std::find( used.begin(), used.end(), 0 ) - used.begin();
+        if( colorOf[d] == (int) colors.size() ){
+            colors.push_back( std::vector<unsigned>() );
+        }
+        colors[ colorOf[d] ].push_back( d );
+    }
+
+#pragma omp parallel for schedule( dynamic )
+    for( int d = 0; d < (int) nDomains; ++d )
+    {
+        Subdomain& sub = *domains[d];
+        assembleBogusFrictionProblem( sub.group, sub.problem, sub.globalIds, sub.vels, sub.impulses,
+                sub.startDofs, sub.nDofs, &sub.interface );
+    }
+
+    const Scalar tolerance = m_params.m_gaussSeidelTolerance;
+    Scalar residual = 0.;
+    bool accept = false;
+    unsigned iter = 0;
+    while( iter < m_params.m_domainDecompositionMaxIters )
+    {
+        ++iter;
+        accept = true;
+
+        for( unsigned c = 0; c < colors.size(); ++c )
+        {
+            const std::vector<unsigned>& color = colors[c];
+            bool colorAccepted = true;
+
+#pragma omp parallel for schedule( dynamic ) reduction( && : colorAccepted )
+            for( int k = 0; k < (int) color.size(); ++k )
+            {
+                Subdomain& sub = *domains[ color[k] ];
+
+                // Current velocities of the strands on the other side of the interface contacts
+                const unsigned firstInterfaceContact = sub.contactIds.size() - sub.interface.size();
+                for( unsigned i = 0; i < sub.interface.size(); ++i )
+                {
+                    const CollidingPair::Object& other = sub.interface[i].objects.second;
+                    const unsigned o = indices.find( other.globalIndex )->second;
+                    sub.problem.updateContactRHS( firstInterfaceContact + i, -other.defGrad.multiply( vels.segment( startDofs[o], nDofs[o] ) ) );
+                }
+
+                // Current impulses of the interface contacts of other subdomains
+                VecXx forces( sub.vels.size() );
+                forces.setZero();
+                for( unsigned i = 0; i < sub.incomingIds.size(); ++i )
+                {
+                    const unsigned m = sub.incomingIds[i];
+                    const CollidingPair::Object& object = mutualContacts[m].objects.second;
+                    const unsigned o = sub.group.first.find( object.globalIndex )->second;
+                    object.defGrad.addTransposeMultiply( impulses.segment<3>( 3 * ( nExternal + m ) ), forces, sub.startDofs[o] );
+                }
+                for( unsigned o = 0; o < sub.globalIds.size(); ++o ){
+                    sub.problem.setAdditionalForces( o, forces.segment( sub.startDofs[o], sub.nDofs[o] ) );
+                }
+
+                // Subdomains are solved sequentially, the team works on the other subdomains of the color
+                omp_set_num_threads( 1 );
+                // Non-linear callbacks stay registered for later sweeps
+                sub.accepted = solveBogusFrictionProblem( sub.problem, sub.globalIds, asFailSafe, nonLinear && iter == 1,
+                        sub.vels, sub.impulses );
+                colorAccepted = colorAccepted && sub.accepted;
+
+                for( unsigned o = 0; o < sub.globalIds.size(); ++o )
+                {
+                    const unsigned g = indices.find( sub.globalIds[o] )->second;
+                    vels.segment( startDofs[g], nDofs[g] ) = sub.vels.segment( sub.startDofs[o], sub.nDofs[o] );
+                }
+                for( unsigned i = 0; i < sub.contactIds.size(); ++i ){
+                    impulses.segment<3>( 3 * sub.contactIds[i] ) = sub.impulses.segment<3>( 3 * i );
+                }
+            }
+            accept = accept && colorAccepted;
+        }
+
+        // Each subdomain has just been solved, only the interface contacts may be off
+        std::vector<Scalar> domainResiduals( nDomains, 0. );
+#pragma omp parallel for
+        for( int d = 0; d < (int) nDomains; ++d )
+        {
+            const Subdomain& sub = *domains[d];
+            for( unsigned i = 0; i < sub.interface.size(); ++i )
+            {
+                const CollidingPair& collision = sub.interface[i];
+                const unsigned a = indices.find( collision.objects.first.globalIndex )->second;
+                const unsigned b = indices.find( collision.objects.second.globalIndex )->second;
+
+                const Vec3 u = collision.m_transformationMatrix.transpose() *
+                    ( collision.objects.first.defGrad.multiply( vels.segment( startDofs[a], nDofs[a] ) )
+                    - collision.objects.second.defGrad.multiply( vels.segment( startDofs[b], nDofs[b] ) ) );
+                const Vec3 r = collision.m_transformationMatrix.transpose() * impulses.segment<3>( 3 * ( nExternal + sub.interfaceIds[i] ) );
+
+                domainResiduals[d] = std::max( domainResiduals[d], coulombResidual( u, r, collision.m_mu ) );
+            }
+        }
+        residual = *std::max_element( domainResiduals.begin(), domainResiduals.end() );
+
+        if( residual < tolerance ){
+            break;
+        }
+    }
+
+    if( residual > std::sqrt( tolerance ) ){ // same criterion as solveBogusFrictionProblem()
+        std::cerr << "Domain decomposition did not converge [ err=" << residual << ", numContacts=" << impulses.size() / 3 << " ] " << std::endl;
+        accept = false;
+    }
+
+    for( unsigned d = 0; d < nDomains; ++d ){
+        delete domains[d];
+    }
+
+    return accept;
+}
@@ -1,13 +1,18 @@
 #include "Simulation.h"
 #include "../Collision/CollisionDetector.h"
 #include "../Collision/ElementProxy.h"
+#include "../Utils/Profiler.h"
 
 void Simulation::deleteInvertedProxies( const bool& penaltyAfter, const bool& penaltyOnce )
 {
+    PROFILE_SCOPE( "twisted bands" );
     if( penaltyAfter )
     {
         for ( std::vector<ElasticStrand*>::size_type i = 0; i < m_strands.size(); i++ )
         {
+            if( !m_activeStrands[i] ){
+                continue;
+            }
             m_collisionDetector->m_proxyHistory->applyImpulses( m_strands[i], m_steppers[i], true );
             // m_steppers[i]->update( true );
         }
@@ -43,4 +48,5 @@ void Simulation::deleteInvertedProxies( const bool& penaltyAfter, const bool& pe
             }
         }
     }  
+    m_metrics.add( SimulationMetrics::BANDS_DELETED, tunneledBands.size() - m_collisionDetector->m_proxyHistory->tunnelingBands.size() );
 }
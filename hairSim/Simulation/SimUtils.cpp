@@ -6,6 +6,8 @@
 #include "../Collision/CollisionUtils/CollisionUtils.h"
 #include "../Collision/VertexFaceCollision.h"
 #include "../Collision/EdgeFaceCollision.h"
+#include "../Mesh/LevelSet.h"
+#include "../Utils/Profiler.h"
 #include <Eigen/Sparse>
 
 #define SECOND_EDGE_MIN_CONTACT_ABSCISSA 0.0001
@@ -17,13 +19,14 @@ void Simulation::accumulateProxies( std::vector< ElementProxy* >& originalProxie
     // Also store edge proxies for collision detection
     
     TwistEdge* last = NULL;
+    int edgeID = 0;
     for( std::vector<ElasticStrand*>::const_iterator strand = m_strands.begin(); strand != m_strands.end(); ++strand )
     {
         m_steppers.push_back( new ImplicitStepper( **strand, m_params ) );
 
         for ( int vtx = 0; vtx < ( *strand )->getNumEdges(); ++vtx )
         {
-            TwistEdge* te = new TwistEdge( **strand, vtx );
+            TwistEdge* te = new TwistEdge( **strand, vtx, edgeID++ );
 
             if( vtx > 0 ){
                 te->prev = last;
@@ -77,6 +80,7 @@ bool Simulation::isCollisionInvariantCT( const Scalar dt )
 
 void Simulation::gatherProximityRodRodCollisions( Scalar dt )
 { // Detect with SpatialHash, then preprocess
+    PROFILE_SCOPE( "rod-rod proximity" );
 
     if( !m_params.m_useProxRodRodCollisions ) return;
 
@@ -101,7 +105,20 @@ void Simulation::gatherProximityRodRodCollisions( Scalar dt )
         maxEdgeLen = std::max( maxEdgeLen, m_strands[i]->getTotalRestLength() / nv );
     }
     m_hashMap->setCellSize( std::max( maxEdgeLen, meanRadius / m_strands.size() ) );
-    m_hashMap->batchUpdate( m_strands, maxNumVert );
+    if( std::find( m_activeStrands.begin(), m_activeStrands.end(), 0 ) == m_activeStrands.end() ){
+        m_hashMap->batchUpdate( m_strands, maxNumVert );
+    }
+    else
+    {
+        std::vector<ElasticStrand*> activeStrands;
+        for( unsigned i = 0; i < m_strands.size(); ++i )
+        {
+            if( m_activeStrands[i] ){
+                activeStrands.push_back( m_strands[i] );
+            }
+        }
+        m_hashMap->batchUpdate( activeStrands, maxNumVert );
+    }
         
     // compute will actually do nothing, except initializing result
     // The collisions will actually be retrieved by batches of 10 objects at each call to result.next
@@ -194,6 +211,8 @@ void Simulation::gatherProximityRodRodCollisions( Scalar dt )
         }
     }
     std::cout << "Prox " << nProx << std::endl;
+    m_metrics.add( SimulationMetrics::PROXIMITY_CANDIDATES, nRough );
+    m_metrics.add( SimulationMetrics::PROXIMITY_CONTACTS, nProx + nExt );
 
     if( m_params.m_simulationManager_limitedMemory )
     {
@@ -206,6 +225,74 @@ void Simulation::gatherProximityRodRodCollisions( Scalar dt )
     }
 }
 
+void Simulation::prepareLevelSets()
+{
+    m_levelSetControllers.clear();
+    for( unsigned m = 0; m < m_meshes.size(); ++m )
+    {
+        TriMeshController* controller = m_meshes[m]->controller();
+        if( controller->hasLevelSet() )
+        {
+            controller->execute( true ); // rebuilds the level set if the mesh deformed
+            m_levelSetControllers.push_back( controller );
+        }
+    }
+}
+
+unsigned Simulation::gatherLevelSetCollisions( unsigned strandIdx, Scalar dt )
+{
+    const std::vector< const TriMeshController* >& controllers = m_levelSetControllers;
+    const ElasticStrand& strand = *m_strands[strandIdx];
+    const Scalar radius = strand.collisionParameters().m_externalCollisionsRadius;
+
+    unsigned nLS = 0;
+    for( int vtx = 1; vtx < (int) strand.getNumVertices() && !controllers.empty(); ++vtx )
+    {
+        const Vec3 start = strand.getVertex( vtx );
+        const Vec3 end = strand.getFutureVertex( vtx );
+
+        for( unsigned c = 0; c < controllers.size(); ++c )
+        {
+            const LevelSet& levelSet = *controllers[c]->getLevelSet();
+            if( levelSet.getValue( end ) >= radius ){
+                continue;
+            }
+
+            // Normal from the start-of-step position when it is inside the band
+            Vec3 normal = levelSet.getGradient( start );
+            if( isSmall( normal.squaredNorm() ) ){
+                normal = levelSet.getGradient( end );
+            }
+            if( isSmall( normal.squaredNorm() ) ){
+                continue;
+            }
+            normal.normalize();
+
+            const bool lastVertex = vtx == (int) strand.getNumEdges();
+            const unsigned edgeIdx = lastVertex ? vtx - 1 : vtx;
+            const Scalar abscissa = lastVertex ? 1. : 0.;
+
+            CollidingPair collision;
+            collision.m_normal = normal;
+            collision.m_mu = sqrt( controllers[c]->getDefaultFrictionCoefficient() * strand.collisionParameters().m_frictionCoefficient );
+
+            collision.objects.first.globalIndex = strandIdx;
+            collision.objects.first.vertex = edgeIdx;
+            collision.objects.first.abscissa = abscissa;
+
+            collision.objects.second.globalIndex = -1;
+            collision.objects.second.vertex = c;
+            collision.objects.second.abscissa = 0.;
+            collision.objects.second.worldVel = levelSet.getRigidVelocity( end, dt );
+
+            if( addExternalContact( strandIdx, edgeIdx, abscissa, collision ) ){
+                ++nLS;
+            }
+        }
+    }
+    return nLS;
+}
+
 bool Simulation::acceptsCollision( const ElasticStrand& strand, int edgeIdx, Scalar localAbscissa )
 {
     if( !edgeIdx || ( edgeIdx == 1 && localAbscissa < SECOND_EDGE_MIN_CONTACT_ABSCISSA ) )
@@ -251,6 +338,7 @@ void Simulation::makeExternalContact( CollidingPair& externalContact, bool onFir
 
 void Simulation::detectContinuousTimeCollisions()
 { // dont clear collisions here since we only process them after gathering all of them in this loop
+    PROFILE_SCOPE( "continuous-time detection" );
     do{ 
         m_collisionDetector->m_proxyHistory->repeatCD = false;
         m_collisionDetector->buildBVH( false );
@@ -260,6 +348,7 @@ void Simulation::detectContinuousTimeCollisions()
 
 void Simulation::preProcessContinuousTimeCollisions( Scalar dt )
 {
+    PROFILE_SCOPE( "continuous-time contacts" );
     std::list< Collision* >& collisionsList = m_collisionDetector->getCollisions();
     if( collisionsList.empty() ){
         return;
@@ -349,6 +438,7 @@ void Simulation::preProcessContinuousTimeCollisions( Scalar dt )
 
     }
     std::cout << "CTCD " << nCTCD << " ext: " << nInt << std::endl;
+    m_metrics.add( SimulationMetrics::CT_CONTACTS, nCTCD + nInt );
 }
 
 bool Simulation::addExternalContact( const unsigned strIdx, const unsigned edgeIdx, const Scalar abscissa, const CollidingPair& externalContact )
@@ -399,6 +489,10 @@ void Simulation::computeCollidingGroups( const CollidingPairs &origMutualCollisi
     }
     std::sort( mutualCollisions.begin(), mutualCollisions.end() );
 
+    if( m_params.m_contactReductionWindow > 0. ){
+        reduceMutualContacts( mutualCollisions );
+    }
+
     // For each strand, list all other contacting ones
     std::vector< std::deque<unsigned> > objsGroups( m_strands.size() );
     for( unsigned i = 0; i < mutualCollisions.size(); ++i )
@@ -467,6 +561,86 @@ void Simulation::computeCollidingGroups( const CollidingPairs &origMutualCollisi
     std::cout << "numCollidingGroups: " << m_collidingGroups.size() << std::endl;
 }
 
+// Position of a contact along its strand, in edges from the root
+static Scalar curvilinearIndex( const CollidingPair::Object& object )
+{
+    return object.vertex + object.abscissa;
+}
+
+static void setCurvilinearIndex( CollidingPair::Object& object, Scalar index, int numEdges )
+{
+    object.vertex = std::min( ( int ) std::floor( index ), numEdges - 1 );
+    object.abscissa = std::min( 1., index - object.vertex );
+}
+
+void Simulation::reduceMutualContacts( CollidingPairs &contacts )
+{
+    const Scalar window = m_params.m_contactReductionWindow;
+    const unsigned nContacts = contacts.size();
+
+    CollidingPairs reduced;
+    reduced.reserve( nContacts );
+
+    unsigned begin = 0;
+    while( begin < nContacts )
+    {
+        const CollidingPair& anchor = contacts[begin];
+
+        // Cluster: following contacts between the same strands, close to the anchor on both of them
+        unsigned end = begin + 1;
+        for( ; end < nContacts; ++end )
+        {
+            const CollidingPair& c = contacts[end];
+            if( c.objects.first.globalIndex != anchor.objects.first.globalIndex
+                || c.objects.second.globalIndex != anchor.objects.second.globalIndex
+                || std::fabs( curvilinearIndex( c.objects.first ) - curvilinearIndex( anchor.objects.first ) ) > window
+                || std::fabs( curvilinearIndex( c.objects.second ) - curvilinearIndex( anchor.objects.second ) ) > window
+                || c.m_normal.dot( anchor.m_normal ) < ALMOST_PARALLEL_COS ){
+                break;
+            }
+        }
+
+        if( end == begin + 1 )
+        {
+            reduced.push_back( anchor );
+            begin = end;
+            continue;
+        }
+
+        // Representative contact at the mean position, with the mean normal and friction coefficient
+        const Scalar weight = 1. / ( end - begin );
+        Scalar first = 0., second = 0., mu = 0.;
+        Vec3 normal = Vec3::Zero(), firstVel = Vec3::Zero(), secondVel = Vec3::Zero();
+        for( unsigned k = begin; k < end; ++k )
+        {
+            const CollidingPair& c = contacts[k];
+            first += weight * curvilinearIndex( c.objects.first );
+            second += weight * curvilinearIndex( c.objects.second );
+            mu += weight * c.m_mu;
+            normal += c.m_normal;
+            firstVel += weight * c.objects.first.worldVel;
+            secondVel += weight * c.objects.second.worldVel;
+        }
+
+        CollidingPair merged( anchor );
+        merged.m_normal = normal.normalized();
+        merged.m_mu = mu;
+        setCurvilinearIndex( merged.objects.first, first, m_strands[ anchor.objects.first.globalIndex ]->getNumEdges() );
+        setCurvilinearIndex( merged.objects.second, second, m_strands[ anchor.objects.second.globalIndex ]->getNumEdges() );
+        merged.objects.first.worldVel = firstVel;
+        merged.objects.second.worldVel = secondVel;
+        reduced.push_back( merged );
+
+        begin = end;
+    }
+
+    m_metrics.add( SimulationMetrics::REDUCTION_INPUT_CONTACTS, nContacts );
+    m_metrics.add( SimulationMetrics::REDUCTION_OUTPUT_CONTACTS, reduced.size() );
+
+    // Clusters are contiguous, so contacts stay ordered by strand pair
+    contacts.swap( reduced );
+}
+
 void Simulation::setupDeformationBasis( CollidingPair &collision ) const
 {
     collision.generateTransformationMatrix();
@@ -478,22 +652,8 @@ void Simulation::setupDeformationBasis( CollidingPair &collision ) const
 
 void Simulation::computeDeformationGradient( CollidingPair::Object &object ) const
 {
-    object.defGrad = new DeformationGradient( 3, m_strands[object.globalIndex]->getCurrentDegreesOfFreedom().rows() );
-    DeformationGradient& H = *(object.defGrad);
-    H.reserve( object.abscissa > 0. ? 6 : 3 );
-    for ( unsigned k = 0; k < 3; ++k )
-    {
-        H.startVec( k );
-        const unsigned col = 4 * object.vertex + k;
-        H.insertBackByOuterInner( k, col ) = ( 1. - object.abscissa );
-
-        if ( object.abscissa > 0. )
-        {
-            H.insertBack( k, col + 4 ) = object.abscissa;
-        }
-    }
-
-    H.finalize();
+    object.defGrad = DeformationGradient( object.vertex, object.abscissa, 
+                                          m_strands[object.globalIndex]->getCurrentDegreesOfFreedom().rows() );
 }
 
 bool Simulation::needsExternalSolve( unsigned strandIdx ) const
@@ -501,8 +661,9 @@ bool Simulation::needsExternalSolve( unsigned strandIdx ) const
     return !m_externalContacts[strandIdx].empty();
 }
 
-void Simulation::solveCollidingGroup( CollidingGroup& collisionGroup, bool asFailSafe, bool nonLinear )
+void Simulation::solveCollidingGroup( CollidingGroup& collisionGroup, bool asFailSafe, bool nonLinear, std::vector<unsigned>* failsafeStrands )
 {
+    PROFILE_SCOPE( "colliding group" );
     if ( collisionGroup.first.empty() ) return;
 
     std::vector<unsigned> globalIds;
@@ -514,7 +675,11 @@ void Simulation::solveCollidingGroup( CollidingGroup& collisionGroup, bool asFai
         bogus::MecheFrictionProblem mecheProblem;
         VecXu startDofs;
         VecXu nDofs;
-        if( assembleBogusFrictionProblem( collisionGroup, mecheProblem, globalIds, vels, impulses, startDofs, nDofs ) ){
+        if( useDomainDecomposition( collisionGroup ) ){
+            accept = solveByDomainDecomposition( collisionGroup, asFailSafe, nonLinear, globalIds, vels, impulses, startDofs, nDofs );
+            postProcessBogusFrictionProblem( accept, collisionGroup, mecheProblem, globalIds, vels, impulses, startDofs, nDofs );
+        }
+        else if( assembleBogusFrictionProblem( collisionGroup, mecheProblem, globalIds, vels, impulses, startDofs, nDofs ) ){
             accept = solveBogusFrictionProblem( mecheProblem, globalIds, asFailSafe, nonLinear, vels, impulses );
             postProcessBogusFrictionProblem( accept, collisionGroup, mecheProblem, globalIds, vels, impulses, startDofs, nDofs );
         }
@@ -535,7 +700,24 @@ void Simulation::solveCollidingGroup( CollidingGroup& collisionGroup, bool asFai
 
     if( mustRetry )
     {
-        if( globalIds.size() > 1 )
+        m_metrics.add( SimulationMetrics::FAILSAFE_GROUPS );
+        for ( unsigned i = 0; i < globalIds.size(); ++i )
+        {
+            if( !accept || m_steppers[globalIds[i]]->lastStepWasRejected() ){
+                m_metrics.add( SimulationMetrics::FAILSAFE_STRANDS );
+            }
+        }
+
+        if( globalIds.size() > 1 && failsafeStrands )
+        { // Left to the caller
+            for ( unsigned i = 0; i < globalIds.size(); ++i )
+            {
+                if( !accept || ( m_steppers[globalIds[i]]->lastStepWasRejected() ) ){
+                    failsafeStrands->push_back( globalIds[i] );
+                }
+            }
+        }
+        else if( globalIds.size() > 1 )
         { // Failed, drop rod-rod collisions, keep external
 #pragma omp parallel for
             for ( unsigned i = 0; i < globalIds.size(); ++i )
@@ -554,24 +736,6 @@ void Simulation::solveCollidingGroup( CollidingGroup& collisionGroup, bool asFai
             stepper.update();
         }
     }
-    
-/*
-    if ( !asFailSafe )
-    { // cleanup some memory
-#pragma omp parallel for
-        for ( unsigned i = 0; i < colPointers.size(); ++i )
-        {
-            CollidingPair& col = *colPointers[i];
-            delete col.objects.first.defGrad;
-            col.objects.first.defGrad = NULL;
-            if ( col.objects.second.globalIndex != -1 )
-            {
-                delete col.objects.second.defGrad;
-                col.objects.second.defGrad = NULL;
-            }
-        }
-    }
-    */
 }
 
 void Simulation::solveOnlyStrandExternal( unsigned objectIdx, bool asFailSafe, bool nonLinear )
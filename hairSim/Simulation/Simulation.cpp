@@ -1,6 +1,8 @@
 #include "Simulation.h"
 #include "../Collision/CollisionDetector.h"
 #include "../Collision/CollisionUtils/SpatialHashMap.hh"
+#include "../Utils/Profiler.h"
+#include "../Utils/ThreadPool.h"
 #include <omp.h>
 
 using namespace std;
@@ -12,13 +14,117 @@ Simulation::Simulation(
 : m_collisionDetector( NULL )
 , m_params( params )
 , m_strands( strands )
+, m_meshes( meshes )
 , m_steppers()
+, m_contactCostRate( 1.e-6 )
 , m_hashMap( NULL )
 {
     std::vector< ElementProxy* > originalProxies;
     accumulateProxies( originalProxies, meshes );
     m_externalContacts.resize( m_strands.size() );
-    m_collisionDetector = new CollisionDetector( originalProxies );
+    m_activeStrands.assign( m_strands.size(), 1 );
+    m_failsafeHistory.assign( m_strands.size(), 0. );
+    m_strandDynamicsCost.assign( m_strands.size(), 0. );
+    m_strandContactCost.assign( m_strands.size(), 0. );
+    m_collisionDetector = new CollisionDetector( originalProxies, m_params.m_cacheStaticMeshBVH );
+
+    // Bands created by the collision detector are numbered after the edges of the strands
+    int numEdges = 0;
+    for( unsigned i = 0; i < m_strands.size(); ++i ){
+        numEdges += m_strands[i]->getNumEdges();
+    }
+    m_collisionDetector->m_proxyHistory->m_edgeCounter = numEdges;
+
+    if( m_params.m_numaMode ){
+        setupNumaShards();
+    }
+    resetPhaseTimes();
+}
+
+void Simulation::setupNumaShards()
+{
+    ThreadPool& pool = ThreadPool::instance();
+    const unsigned nThreads = pool.numThreads();
+
+    // Contiguous blocks of strands with about the same number of vertices: neighbouring strands, which
+    // collide with each other, are usually created one after the other and end up on the same node
+    Scalar totalVertices = 0.;
+    for( unsigned i = 0; i < m_strands.size(); ++i ){
+        totalVertices += m_strands[i]->getNumVertices();
+    }
+    m_strandHomes.resize( m_strands.size() );
+    std::vector<unsigned> nodeStrands( pool.numNodes(), 0 );
+    Scalar vertices = 0.;
+    for( unsigned i = 0; i < m_strands.size(); ++i )
+    {
+        m_strandHomes[i] = std::min( nThreads - 1, ( unsigned ) ( nThreads * vertices / totalVertices ) );
+        vertices += m_strands[i]->getNumVertices();
+        ++nodeStrands[ pool.threadNode( m_strandHomes[i] ) ];
+    }
+
+    // First touch: the steppers, and the states' cached quantities, are reallocated by the strands' home threads
+    TaskGroup tasks( pool );
+    for( unsigned i = 0; i < m_strands.size(); ++i )
+    {
+        tasks.runOn( m_strandHomes[i], [this, i]()
+        {
+            delete m_steppers[i];
+            m_steppers[i] = new ImplicitStepper( *m_strands[i], m_params );
+            m_strands[i]->getCurrentState().reallocate();
+            m_strands[i]->getFutureState().reallocate();
+        } );
+    }
+    tasks.wait();
+
+    std::cout << "# NUMA shards:";
+    for( unsigned n = 0; n < nodeStrands.size(); ++n ){
+        std::cout << " " << nodeStrands[n];
+    }
+    std::cout << " strands" << std::endl;
+}
+
+void Simulation::setActiveStrands( const std::vector<char>& active )
+{
+    if( active == m_activeStrands ){
+        return;
+    }
+    m_activeStrands = active;
+
+    // The hash map only updates the strands it is given, the ones left out would stay in it
+    if( m_hashMap ){
+        m_hashMap->clear();
+    }
+    const bool allActive = std::find( m_activeStrands.begin(), m_activeStrands.end(), 0 ) == m_activeStrands.end();
+    m_collisionDetector->setActiveStrands( allActive ? NULL : &m_activeStrands );
+}
+
+unsigned Simulation::homeThread( unsigned strandIdx ) const
+{
+    return m_strandHomes.empty() ? ThreadPool::threadIndex() : m_strandHomes[strandIdx];
+}
+
+template< typename Func >
+void Simulation::queueStrandTasks( TaskGroup& tasks, const std::vector<unsigned>& strands, const Func& func, int grain ) const
+{
+    // Chunks keep the order of \p strands within each home thread
+    std::vector< std::vector<unsigned> > homes( m_strandHomes.empty() ? 1 : ThreadPool::instance().numThreads() );
+    for( unsigned k = 0; k < strands.size(); ++k ){
+        homes[ m_strandHomes.empty() ? 0 : m_strandHomes[ strands[k] ] ].push_back( strands[k] );
+    }
+
+    for( unsigned t = 0; t < homes.size(); ++t )
+    {
+        for( unsigned first = 0; first < homes[t].size(); first += grain )
+        {
+            const std::vector<unsigned> chunk( homes[t].begin() + first, homes[t].begin() + std::min( first + grain, ( unsigned ) homes[t].size() ) );
+            tasks.runOn( m_strandHomes.empty() ? ThreadPool::threadIndex() : t, [chunk, &func]()
+            {
+                for( unsigned k = 0; k < chunk.size(); ++k ){
+                    func( chunk[k] );
+                }
+            } );
+        }
+    }
 }
 
 Simulation::~Simulation()
@@ -33,20 +139,27 @@ Simulation::~Simulation()
     delete m_collisionDetector;
 }
 
-int hIter;
-bool hLoop = false;
-bool traversalsOn = false;
-bool trackGeometricRelations = true;
-bool penaltyAfter = true;
-bool penaltyOnce = true;
 void Simulation::step( const Scalar& dt )
 {
-    hIter = 0;
+    PROFILE_SCOPE( "step" );
+    int hIter = 0;
     int hMaxIter = 5;
     bool collisionResolution = true;
 
+    m_metrics.clear();
+    const double stepStart = omp_get_wtime();
+
+    // Adds the time since the last lap to the given phase
+    double lapStart = stepStart;
+    auto lap = [&]( Phase phase ) {
+        const double now = omp_get_wtime();
+        m_phaseTimes[phase] += now - lapStart;
+        lapStart = now;
+    };
+
     step_prepare( dt );
-    step_dynamics( dt );
+    step_dynamics( dt ); // also gathers the level set contacts of each strand
+    lap( PHASE_DYNAMICS );
 
     if( collisionResolution ){
         gatherProximityRodRodCollisions( dt );
@@ -54,11 +167,13 @@ void Simulation::step( const Scalar& dt )
         preProcessContinuousTimeCollisions( dt );
 
         step_processCollisions( dt ); // this takes care of current collisions
+        lap( PHASE_COLLISION_DETECTION );
         step_solveCollisions(); // This is where collisions get solved and strands are finalized() (dV & dX accepted)            
     }
 
-    if( hLoop )
+    if( m_params.m_hLoop )
     {
+        PROFILE_SCOPE( "hLoop" );
         cout << "entering hloop" << endl;
         while( hIter < hMaxIter && !isCollisionInvariantCT( dt ) )
         {
@@ -69,140 +184,447 @@ void Simulation::step( const Scalar& dt )
         }
         cout << "hIter: " << hIter << endl;
     }
+    lap( PHASE_COLLISION_SOLVE );
 
     // No further dynamics on strands beyond this point, just book-keeping
 
-    if( trackGeometricRelations )
+    if( m_params.m_trackGeometricRelations )
     {
+        PROFILE_SCOPE( "geometric relations" );
         m_collisionDetector->clear();
         m_collisionDetector->m_proxyHistory->trackTunneling = true;
+        const unsigned numBands = m_collisionDetector->m_proxyHistory->tunnelingBands.size();
         detectContinuousTimeCollisions(); // create and detect loop for missed collisions
+        m_metrics.add( SimulationMetrics::BANDS_CREATED, m_collisionDetector->m_proxyHistory->tunnelingBands.size() - numBands );
         m_collisionDetector->m_proxyHistory->m_frozenScene = true;
         
-        deleteInvertedProxies( penaltyAfter, penaltyOnce );
+        deleteInvertedProxies( m_params.m_penaltyAfter, m_params.m_penaltyOnce );
     }
+    lap( PHASE_GEOMETRIC_RELATIONS );
 
     step_finish();
+    lap( PHASE_FINISH );
+    m_metrics.setStepTime( omp_get_wtime() - stepStart );
+}
+
+const char* Simulation::phaseName( Phase phase )
+{
+    static const char* names[NUM_PHASES] = { "dynamics", "collision detection", "collision solve", "geometric relations", "finish" };
+    return names[phase];
+}
+
+void Simulation::resetPhaseTimes()
+{
+    std::fill( m_phaseTimes, m_phaseTimes + NUM_PHASES, 0. );
 }
 
 void Simulation::step_prepare( Scalar dt )
 {
+    PROFILE_SCOPE( "prepare" );
     for ( unsigned i = 0; i < m_externalContacts.size(); ++i )
     {
         m_externalContacts[i].clear();
     }
     m_mutualContacts.clear();
 
+    // Impulses solved during the last step become this step's initial guesses
+    m_previousImpulses.swap( m_currentImpulses );
+    m_currentImpulses.clear();
+
     m_collisionDetector->m_proxyHistory->m_frozenScene = false;
     m_collisionDetector->m_proxyHistory->trackTunneling = false;
 }
 
 void Simulation::step_dynamics( Scalar dt )
 {
+    PROFILE_SCOPE( "dynamics" );
+    prepareLevelSets();
+
+    // Longest strands first, from their last measured times or their number of vertices at the first step,
+    // so that the dynamic schedule ends with the cheapest ones
+    std::vector< std::pair< std::pair<Scalar, int>, unsigned > > costs;
+    for( unsigned i = 0; i < m_strands.size(); ++i )
+    {
+        if( m_activeStrands[i] ){
+            costs.push_back( std::make_pair( std::make_pair( -m_strandDynamicsCost[i], -( int ) m_strands[i]->getNumVertices() ), i ) );
+        }
+    }
+    std::sort( costs.begin(), costs.end() );
+    std::vector<unsigned> order( costs.size() );
+    for( unsigned k = 0; k < costs.size(); ++k ){
+        order[k] = costs[k].second;
+    }
+
     // Dynamics system assembly
-#pragma omp parallel for schedule(dynamic, 10)
-    for( std::vector< ElasticStrand* >::size_type i = 0; i < m_strands.size(); ++i )
+    TaskGroup tasks;
+    queueStrandTasks( tasks, order, [&]( unsigned i )
     {
+        const double start = omp_get_wtime();
+
         m_steppers[i]->setDt( dt ); // required for checkpointing, this needs to be here so long as anything occurs before startSubstep
-        m_collisionDetector->m_proxyHistory->applyImpulses( m_strands[i], m_steppers[i], !penaltyAfter );
+        m_collisionDetector->m_proxyHistory->applyImpulses( m_strands[i], m_steppers[i], !m_params.m_penaltyAfter );
 
         m_steppers[i]->startStep( dt );
-        m_steppers[i]->solveUnconstrained( true, !penaltyAfter );
+        m_steppers[i]->solveUnconstrained( true, !m_params.m_penaltyAfter );
         m_steppers[i]->update();
-    }
+        m_metrics.sample( SimulationMetrics::NEWTON_ITERATIONS, m_steppers[i]->newtonIterations() );
+        if( m_steppers[i]->notSPD() ){
+            m_metrics.add( SimulationMetrics::NOT_SPD );
+        }
+
+        // Mesh contacts only need this strand's future positions, no need to wait for the others
+        m_metrics.add( SimulationMetrics::LEVEL_SET_CONTACTS, gatherLevelSetCollisions( i, dt ) );
+
+        m_strandDynamicsCost[i] = .5 * ( m_strandDynamicsCost[i] + omp_get_wtime() - start );
+    }, 10 );
+    tasks.wait();
 }
 
-static const unsigned maxObjForOuterParallelism = 8 * omp_get_max_threads();
 void Simulation::step_processCollisions( Scalar dt )
 {
+    PROFILE_SCOPE( "colliding groups" );
     m_collidingGroups.clear();
     m_collidingGroupsIdx.assign( m_strands.size(), -1 );
     computeCollidingGroups( m_mutualContacts );
+    for( unsigned i = 0; i < m_collidingGroups.size(); ++i )
+    {
+        m_metrics.sample( SimulationMetrics::GROUP_STRANDS, m_collidingGroups[i].first.size() );
+        m_metrics.sample( SimulationMetrics::GROUP_CONTACTS, m_collidingGroups[i].second.size() );
+    }
 
-    // Deformation gradients at constraints
-    unsigned nExternalContacts = 0;
-#pragma omp parallel for reduction ( + : nExternalContacts )
-    for ( std::vector<ElasticStrand*>::size_type i = 0; i < m_strands.size(); i++ )
+    // Deformation gradients at constraints are set up by the tasks that solve them, see step_solveCollisions()
+    parallel_for( 0, ( int ) m_strands.size(), [&]( int i )
     {
         std::sort( m_externalContacts[i].begin(), m_externalContacts[i].end() );
+    } );
+}
+
+void Simulation::setupExternalDeformationBases( unsigned strandIdx )
+{
+    for( unsigned k = 0; k < m_externalContacts[strandIdx].size(); ++k )
+    {
+        setupDeformationBasis( m_externalContacts[strandIdx][k] );
+    }
+}
+
+void Simulation::setupDeformationBases( CollidingGroup& cg )
+{
+    std::vector<unsigned> strands;
+    strands.reserve( cg.first.size() );
+    for( IndicesMap::const_iterator it = cg.first.begin(); it != cg.first.end(); ++it ){
+        strands.push_back( it->first );
+    }
 
-        for( unsigned k = 0; k < m_externalContacts[i].size(); ++k )
+    // Only groups solved by a thread team may spawn threads, see step_solveCollisions()
+#pragma omp parallel if( omp_get_max_threads() > 1 )
+    {
+#pragma omp for nowait
+        for ( int k = 0; k < ( int ) cg.second.size(); ++k )
+        {
+            setupDeformationBasis( cg.second[k] );
+        }
+#pragma omp for
+        for ( int k = 0; k < ( int ) strands.size(); ++k )
         {
-            setupDeformationBasis( m_externalContacts[i][k] );
+            setupExternalDeformationBases( strands[k] );
         }
-        nExternalContacts += m_externalContacts[i].size();
     }
+}
+
+// Relative cost of a contact row over a strand dof: each one adds a Delassus block and is visited by every sweep
+static const Scalar contactWorkWeight = 10.;
 
-#pragma omp parallel for
-    for ( std::vector<CollidingGroup>::size_type i = 0; i < m_collidingGroups.size(); i++ )
+Scalar Simulation::contactWork( unsigned strandIdx ) const
+{
+    return 4. * m_strands[strandIdx]->getNumVertices() - 1. + contactWorkWeight * m_externalContacts[strandIdx].size();
+}
+
+Scalar Simulation::contactWork( const CollidingGroup& cg ) const
+{
+    Scalar work = contactWorkWeight * cg.second.size();
+    for( IndicesMap::const_iterator it = cg.first.begin(); it != cg.first.end(); ++it ){
+        work += contactWork( it->first );
+    }
+    return work;
+}
+
+Scalar Simulation::predictContactCost( const CollidingGroup& cg ) const
+{
+    // Groups change from one step to the next, but their strands' share of the past solves still tells
+    // how hard they are to solve
+    Scalar history = 0.;
+    for( IndicesMap::const_iterator it = cg.first.begin(); it != cg.first.end(); ++it ){
+        history += m_strandContactCost[it->first];
+    }
+    const Scalar model = m_contactCostRate * contactWork( cg );
+    return history > 0. ? .5 * ( model + history ) : model;
+}
+
+void Simulation::scheduleCollidingGroups( std::vector<unsigned>& order, std::vector<char>& skipCoupledSolve,
+                                          std::vector<int>& teamSizes, std::vector<unsigned>& loneStrands ) const
+{
+    const unsigned nGroups = m_collidingGroups.size();
+    std::vector< std::pair<Scalar, unsigned> > costs( nGroups );
+    skipCoupledSolve.assign( nGroups, 0 );
+    teamSizes.assign( nGroups, 0 );
+
+    Scalar totalCost = 0.;
+    for( unsigned i = 0; i < nGroups; ++i )
     {
-        CollidingGroup& cg = m_collidingGroups[i];
+        const CollidingGroup& cg = m_collidingGroups[i];
 
-        if ( cg.first.size() < maxObjForOuterParallelism ){
-            for ( unsigned k = 0; k < cg.second.size(); ++k )
-            {
-                setupDeformationBasis( cg.second[k] );
+        // Failure risk from the recent failsafes and the stretch of the unconstrained step
+        Scalar history = 0., stretch = 0.;
+        for( IndicesMap::const_iterator it = cg.first.begin(); it != cg.first.end(); ++it )
+        {
+            history = std::max( history, m_failsafeHistory[it->first] );
+            stretch = std::max( stretch, m_steppers[it->first]->lastStretchRatio() );
+        }
+        const Scalar risk = std::min( 1., .5 * history + std::min( 1., stretch ) );
+
+        skipCoupledSolve[i] = m_params.m_failsafePredictionThreshold > 0. && history >= m_params.m_failsafePredictionThreshold;
+
+        // A failed coupled solve is followed by one external solve per strand
+        Scalar cost = 0.;
+        if( skipCoupledSolve[i] )
+        {
+            for( IndicesMap::const_iterator it = cg.first.begin(); it != cg.first.end(); ++it ){
+                cost += m_contactCostRate * contactWork( it->first );
             }
         }
+        else{
+            cost = ( 1. + risk ) * predictContactCost( cg );
+        }
+        costs[i] = std::make_pair( -cost, i );
+        totalCost += cost;
     }
 
-    for( std::vector<CollidingGroup>::size_type i = 0; i < m_collidingGroups.size(); i++ )
+    std::vector< std::pair<Scalar, unsigned> > loneCosts;
+    for( unsigned i = 0; i < m_strands.size(); ++i )
     {
-        CollidingGroup& cg = m_collidingGroups[i];
+        if( m_collidingGroupsIdx[i] == -1 && m_activeStrands[i] )
+        {
+            const Scalar cost = needsExternalSolve( i ) ? m_contactCostRate * contactWork( i ) : 0.;
+            loneCosts.push_back( std::make_pair( -cost, i ) );
+            totalCost += cost;
+        }
+    }
 
-        if ( cg.first.size() >= maxObjForOuterParallelism )
+    std::sort( costs.begin(), costs.end() );
+    order.resize( nGroups );
+    for( unsigned i = 0; i < nGroups; ++i ){
+        order[i] = costs[i].second;
+    }
+
+    std::sort( loneCosts.begin(), loneCosts.end() );
+    loneStrands.resize( loneCosts.size() );
+    for( unsigned i = 0; i < loneCosts.size(); ++i ){
+        loneStrands[i] = loneCosts[i].second;
+    }
+
+    // Groups longer than a fair share would be the tail of the parallel loop, they get a team of threads
+    // sized to their cost instead. Colored GS and domain decomposition only pay off with several threads
+    const int nThreads = omp_get_max_threads();
+    if( nThreads < 2 ){
+        return;
+    }
+    Scalar largeCost = 0.;
+    for( unsigned k = 0; k < nGroups; ++k )
+    {
+        const unsigned i = order[k];
+        const CollidingGroup& cg = m_collidingGroups[i];
+        if( skipCoupledSolve[i] ){
+            continue;
+        }
+        if( -costs[k].first * nThreads > totalCost
+            || ( m_params.m_coloredGSContactThreshold > 0 && cg.second.size() >= m_params.m_coloredGSContactThreshold )
+            || useDomainDecomposition( cg ) )
         {
-#pragma omp parallel for
-            for ( unsigned k = 0; k < cg.second.size(); ++k )
-            {
-                setupDeformationBasis( cg.second[k] );
-            }
+            teamSizes[i] = 1;
+            largeCost -= costs[k].first;
+        }
+    }
+    for( unsigned k = 0; k < nGroups; ++k )
+    {
+        const unsigned i = order[k];
+        if( teamSizes[i] ){
+            teamSizes[i] = std::max( 1, ( int ) ( nThreads * ( -costs[k].first ) / largeCost ) );
         }
     }
 }
 
-void Simulation::step_solveCollisions()
+void Simulation::updateContactCosts( const std::vector<Scalar>& contactTimes )
 {
-    // Contact solve
-#pragma omp parallel for
-    for( std::vector<CollidingGroup>::size_type i = 0; i < m_collidingGroups.size(); ++i )
+    Scalar time = 0., work = 0.;
+    for( unsigned i = 0; i < m_collidingGroups.size(); ++i ){
+        work += contactWork( m_collidingGroups[i] );
+    }
+    for( unsigned i = 0; i < m_strands.size(); ++i )
     {
-        if( m_collidingGroups[i].first.size() <= maxObjForOuterParallelism ){
-            solveCollidingGroup( m_collidingGroups[i], false, m_params.m_alwaysUseNonLinear );
+        if( m_collidingGroupsIdx[i] == -1 && contactTimes[i] > 0. ){
+            work += contactWork( i );
         }
+        time += contactTimes[i];
+        m_strandContactCost[i] = .5 * ( m_strandContactCost[i] + contactTimes[i] );
+    }
+    if( work > 0. ){
+        m_contactCostRate = .5 * ( m_contactCostRate + time / work );
     }
+}
 
-    for( unsigned i = 0; i < m_collidingGroups.size(); ++i )
+void Simulation::step_solveCollisions()
+{
+    PROFILE_SCOPE( "solve collisions" );
+    // Groups are started from the most expensive and likely to fail, so that they do not end up
+    // in the tail of the parallel loop. Their failsafes are gathered and run afterwards as a single
+    // parallel loop over strands, instead of serially by the thread that solved the group
+    std::vector<unsigned> order;
+    std::vector<char> skipCoupledSolve;
+    std::vector<int> teamSizes;
+    std::vector<unsigned> loneStrands;
+    scheduleCollidingGroups( order, skipCoupledSolve, teamSizes, loneStrands );
+
+    std::vector< std::vector<unsigned> > failsafeStrands( m_collidingGroups.size() );
+    std::vector<Scalar> contactTimes( m_strands.size(), 0. ); // Each group's time is shared by its strands
+
+    // Large groups are solved concurrently, each by its own team of threads
+    std::vector<unsigned> largeGroups;
+    for( unsigned k = 0; k < order.size(); ++k )
     {
-        if( m_collidingGroups[i].first.size() > maxObjForOuterParallelism ){
-            solveCollidingGroup( m_collidingGroups[i], false, m_params.m_alwaysUseNonLinear );
+        if( teamSizes[order[k]] ){
+            largeGroups.push_back( order[k] );
         }
     }
+    if( !largeGroups.empty() )
+    {
+        const int maxActiveLevels = omp_get_max_active_levels();
+        omp_set_max_active_levels( std::max( maxActiveLevels, 2 ) );
+
+#pragma omp parallel for schedule( dynamic ) num_threads( std::min( ( int ) largeGroups.size(), omp_get_max_threads() ) )
+        for( int k = 0; k < ( int ) largeGroups.size(); ++k )
+        {
+            const unsigned i = largeGroups[k];
+            const double start = omp_get_wtime();
+
+            omp_set_num_threads( teamSizes[i] ); // Size of the nested parallel regions of this group
+            setupDeformationBases( m_collidingGroups[i] );
+            solveCollidingGroup( m_collidingGroups[i], false, m_params.m_alwaysUseNonLinear, &failsafeStrands[i] );
+
+            const Scalar time = ( omp_get_wtime() - start ) / m_collidingGroups[i].first.size();
+            for( IndicesMap::const_iterator it = m_collidingGroups[i].first.begin(); it != m_collidingGroups[i].first.end(); ++it ){
+                contactTimes[it->first] = time;
+            }
+        }
+
+        omp_set_max_active_levels( maxActiveLevels );
 
-#pragma omp parallel for
-    for( std::vector<ElasticStrand*>::size_type i = 0; i < m_strands.size(); ++i )
+        for( unsigned k = 0; k < largeGroups.size(); ++k ){
+            m_metrics.sample( SimulationMetrics::TEAM_SIZE, teamSizes[largeGroups[k]] );
+        }
+    }
+
+    // Each group sets up its own deformation bases and is solved right away, and strands outside of
+    // groups are queued behind them: no thread waits for the whole set up, nor for the slowest group.
+    // Tasks of the pool are sequential, see setupDeformationBases() and solveBogusFrictionProblem()
     {
-        if ( m_collidingGroupsIdx[i] == -1 ){
+        TaskGroup tasks;
+        for( unsigned k = 0; k < order.size(); ++k )
+        {
+            const unsigned i = order[k];
+            if( teamSizes[i] ){
+                continue;
+            }
+            tasks.runOn( homeThread( m_collidingGroups[i].first.begin()->first ), [&, i]()
+            {
+                const double start = omp_get_wtime();
+
+                setupDeformationBases( m_collidingGroups[i] );
+                if( skipCoupledSolve[i] )
+                {
+                    for( IndicesMap::const_iterator it = m_collidingGroups[i].first.begin(); it != m_collidingGroups[i].first.end(); ++it ){
+                        failsafeStrands[i].push_back( it->first );
+                    }
+                }
+                else{
+                    solveCollidingGroup( m_collidingGroups[i], false, m_params.m_alwaysUseNonLinear, &failsafeStrands[i] );
+                }
+
+                const Scalar time = ( omp_get_wtime() - start ) / m_collidingGroups[i].first.size();
+                for( IndicesMap::const_iterator it = m_collidingGroups[i].first.begin(); it != m_collidingGroups[i].first.end(); ++it ){
+                    contactTimes[it->first] = time;
+                }
+            } );
+        }
+
+        queueStrandTasks( tasks, loneStrands, [&]( unsigned i )
+        {
             if ( needsExternalSolve( i ) ){
+                const double start = omp_get_wtime();
+                setupExternalDeformationBases( i );
                 solveOnlyStrandExternal( i, false, m_params.m_alwaysUseNonLinear );
+                contactTimes[i] = omp_get_wtime() - start;
             }
             else if( m_params.m_alwaysUseNonLinear && !m_steppers[i]->usedNonLinearSolver() ){
                 m_steppers[i]->resetStep();
                 m_steppers[i]->solveUnconstrained( true );
                 m_steppers[i]->update();
             }
+        }, 10 );
+        tasks.wait();
+    }
+
+    std::vector<unsigned> failsafe;
+    for( unsigned i = 0; i < failsafeStrands.size(); ++i ){
+        failsafe.insert( failsafe.end(), failsafeStrands[i].begin(), failsafeStrands[i].end() );
+    }
+
+    // Failed, drop rod-rod collisions, keep external
+    {
+        TaskGroup tasks;
+        queueStrandTasks( tasks, failsafe, [&]( unsigned i )
+        {
+            const double start = omp_get_wtime();
+            solveOnlyStrandExternal( i, true, m_params.m_useNonLinearAsFailsafe || m_params.m_alwaysUseNonLinear );
+            contactTimes[i] += omp_get_wtime() - start;
+        }, 1 );
+        tasks.wait();
+    }
+
+    for( unsigned s = 0; s < m_failsafeHistory.size(); ++s ){
+        m_failsafeHistory[s] *= .5;
+    }
+    // Only failures of a coupled solve count, so that the history of skipped groups decays and they get retried
+    for( unsigned i = 0; i < failsafeStrands.size(); ++i )
+    {
+        if( skipCoupledSolve[i] ){
+            continue;
+        }
+        for( unsigned k = 0; k < failsafeStrands[i].size(); ++k ){
+            m_failsafeHistory[ failsafeStrands[i][k] ] += 1.;
         }
     }
+    updateContactCosts( contactTimes );
+
     m_mutualContacts.clear();    
 }
 
 void Simulation::step_finish()
 {
-#pragma omp parallel for
-    for( std::vector<ElasticStrand*>::size_type i = 0; i < m_strands.size(); ++i )
+    PROFILE_SCOPE( "finish" );
+    std::vector<unsigned> strands;
+    for( unsigned i = 0; i < m_strands.size(); ++i )
     {
-        m_steppers[i]->finalize(); // Accept and finish with strand motion
+        if( m_activeStrands[i] ){
+            strands.push_back( i );
+        }
     }
+
+    TaskGroup tasks;
+    queueStrandTasks( tasks, strands, [&]( unsigned i )
+    {
+        m_steppers[i]->finalize(); // Accept and finish with strand motion
+    }, 10 );
+    tasks.wait();
     m_collisionDetector->clear();
     m_mutualContacts.clear();
 }
@@ -212,6 +634,7 @@ void Simulation::updateParameters( const SimulationParameters& params )
     { // Enforce desired or maximum number of threads
         const int numThreads = params.m_numberOfThreads > 0 ? params.m_numberOfThreads : sysconf( _SC_NPROCESSORS_ONLN );
         omp_set_num_threads( numThreads );
+        ThreadPool::instance().resize( numThreads );
     }
     m_params = params;
 }
@@ -2,6 +2,7 @@
 #define SIMULATION_H
 
 #include "SimulationParameters.h"
+#include "SimulationMetrics.h"
 
 #include "../Utils/Definitions.h"
 #include "../Collision/CollisionUtils/SpatialHashMapFwd.hh"
@@ -20,13 +21,25 @@ class ImplicitStepper;
 class CollisionDetector;
 class CollisionBase;
 class TriMesh;
+class TriMeshController;
 class ElementProxy;
+class TaskGroup;
 
 //! Map between a index in the simulation to an index in a colliding group
 typedef std::map<unsigned, unsigned> IndicesMap;
 //! Colliding group: set of strands and contacts that should be solved together
 typedef std::pair<IndicesMap, CollidingPairs> CollidingGroup;
 
+//! Impulse of a contact at the previous step, used to warm-start the friction solve
+struct CachedImpulse
+{
+    Scalar abscissae[2];
+    Vec3 normal;
+    Vec3 impulse; //!< World space
+};
+//! Contacts indexed by ( strand, edge ) of both objects
+typedef std::multimap< std::pair< std::pair<int, int>, std::pair<int, int> >, CachedImpulse > ImpulseCache;
+
 class Simulation
 {
 public:
@@ -40,6 +53,33 @@ public:
     //! Performs a simulation substep
     void step( const Scalar& dt );
 
+    //! Parts of a step whose wall times are accumulated
+    enum Phase
+    {
+        PHASE_DYNAMICS = 0, //!< Unconstrained dynamics and mesh level set contacts
+        PHASE_COLLISION_DETECTION, //!< Rod-rod proximity, continuous-time detection, colliding groups
+        PHASE_COLLISION_SOLVE, //!< Friction solves of the groups, hLoop included
+        PHASE_GEOMETRIC_RELATIONS, //!< Tracking of missed collisions as twisted bands
+        PHASE_FINISH,
+        NUM_PHASES
+    };
+
+    static const char* phaseName( Phase phase );
+
+    //! Wall time spent in \p phase since the last call to resetPhaseTimes(), in seconds
+    double phaseTime( Phase phase ) const
+    { return m_phaseTimes[phase]; }
+
+    void resetPhaseTimes();
+
+    //! Counters and histograms of the last step
+    const SimulationMetrics& metrics() const
+    { return m_metrics; }
+
+    //! Strands left out are neither stepped nor collided, eg. the ghosts of a distributed simulation outside of the halo
+    /*! \p active has one flag per strand; all strands are active until this is called */
+    void setActiveStrands( const std::vector<char>& active );
+
     CollisionDetector* m_collisionDetector; //!< BVH-based collision detector
 
 private:
@@ -69,6 +109,14 @@ private:
 
     void gatherProximityRodRodCollisions( Scalar dt );
 
+    //! Rebuilds the meshes' signed distance fields if needed, and lists those that can be used
+    void prepareLevelSets();
+
+    //! Vertex/mesh proximity contacts of one strand from the meshes' signed distance fields
+    /*! Only depends on the strand's own dofs, so it runs as soon as its dynamics are solved
+        \return the number of contacts added */
+    unsigned gatherLevelSetCollisions( unsigned strandIdx, Scalar dt );
+
     //! Returns whether a collision is deemed acceptable ( not too close to the root, etc )
     static bool acceptsCollision( const ElasticStrand& strand, int edgeIdx, Scalar localAbscissa );
 
@@ -87,8 +135,17 @@ private:
     //! Computes the colliding groups using a graph walking algorithm
     void computeCollidingGroups( const CollidingPairs &mutualCollisions );
 
+    //! Merges the nearly coincident contacts between each pair of strands into representative ones
+    /*! \p contacts must be sorted. Contacts are merged when they lie within m_contactReductionWindow edges
+        of the first one of their cluster on both strands, with almost parallel normals */
+    void reduceMutualContacts( CollidingPairs &contacts );
+
     //! Setup the local frame for one contact and calls computeDeformationGradient() for each object
     void setupDeformationBasis( CollidingPair &collision ) const;
+    //! setupDeformationBasis() on the mutual contacts of a group and on the external contacts of its strands
+    void setupDeformationBases( CollidingGroup &cg );
+    //! setupDeformationBasis() on the external contacts of one strand
+    void setupExternalDeformationBases( unsigned strandIdx );
 
     //! Computes the deformation gradient of a strand at one contact point, ie dq/dx
     void computeDeformationGradient( CollidingPair::Object &object ) const;
@@ -98,26 +155,78 @@ private:
     bool needsExternalSolve( unsigned strandIdx ) const;    
 
     //! Solve the contacts and constraints on a colliding group
-    void solveCollidingGroup( CollidingGroup &cg, bool asFailSafe, bool nonLinear );
+    /*! If \p failsafeStrands is not NULL, the strands that have to be solved again without rod-rod
+        contacts are appended to it instead of being solved right away */
+    void solveCollidingGroup( CollidingGroup &cg, bool asFailSafe, bool nonLinear, std::vector<unsigned>* failsafeStrands = NULL );
+
+    //! Work of a contact solve in the units of the cost model, from the strands' dofs and the number of contacts
+    Scalar contactWork( const CollidingGroup &cg ) const;
+    Scalar contactWork( unsigned strandIdx ) const;
+
+    //! Predicted time of the coupled solve of a group, from its work and its strands' past solve times
+    Scalar predictContactCost( const CollidingGroup &cg ) const;
+
+    //! Orders the colliding groups and the strands outside of groups by decreasing expected cost, failsafe included
+    /*! \p skipCoupledSolve tells the groups that are predicted to fail from their strands' history.
+        \p teamSizes is the number of threads given to each group, 0 for the groups left to the parallel loop
+        over groups -- a group gets its own team when it would take longer than a thread's fair share of the work */
+    void scheduleCollidingGroups( std::vector<unsigned>& order, std::vector<char>& skipCoupledSolve,
+                                  std::vector<int>& teamSizes, std::vector<unsigned>& loneStrands ) const;
+
+    //! Updates the cost model from the measured contact solve time of each strand during this step
+    void updateContactCosts( const std::vector<Scalar>& contactTimes );
+
+    //! NUMA mode: gives each strand a home thread of the pool, and reallocates its data from there
+    void setupNumaShards();
+    //! Thread whose deque gets the tasks of a strand: its home thread in NUMA mode, the calling one otherwise
+    unsigned homeThread( unsigned strandIdx ) const;
+    //! Queues func( strandIdx ) for each of \p strands, by chunks of \p grain, on their home threads
+    template< typename Func >
+    void queueStrandTasks( TaskGroup& tasks, const std::vector<unsigned>& strands, const Func& func, int grain ) const;
 
     //! Solve the contacts and constraints on a single object
     void solveOnlyStrandExternal( const unsigned objectIdx, bool asFailSafe, bool nonLinear );
 
 //// SimBogusUtils.cpp
 
+    //! Sets up the friction problem of a colliding group
+    /*! \p interfaceContacts are mutual contacts whose second strand is not part of the group,
+        and are added as external contacts on their first strand, after the group's own contacts */
     bool assembleBogusFrictionProblem( CollidingGroup& collisionGroup, bogus::MecheFrictionProblem& mecheProblem,
             std::vector<unsigned> &globalIds, VecXx& vels, VecXx& impulses,
-            VecXu& startDofs, VecXu& nDofs );
+            VecXu& startDofs, VecXu& nDofs, const CollidingPairs* interfaceContacts = NULL );
 
     //! Proper solving of the MecheFrictionProblem
     bool solveBogusFrictionProblem( bogus::MecheFrictionProblem& mecheProblem, const std::vector<unsigned> &globalIds,
             bool asFailSafe, bool nonLinear, VecXx& vels, VecXx& impulses );
 
+    //! Fills \p impulse with the previous-step impulse of a matching contact, rotated to the new normal
+    /*! \return whether a matching contact was found */
+    bool warmStartImpulse( const CollidingPair& collision, Vec3& impulse ) const;
+
+    //! Remembers the impulses of a solved group for the next step ( same contact order as the assembly )
+    void cacheImpulses( const CollidingGroup& collisionGroup, const VecXx& impulses );
+
     //! Cleanup a friction problem and updates the strands with the new velocities if \p accept is true
     void postProcessBogusFrictionProblem( bool accept, CollidingGroup& collisionGroup,
             const bogus::MecheFrictionProblem& mecheProblem, const std::vector<unsigned> &globalIds,
             VecXx& vels, VecXx& impulses, VecXu& startDofs, VecXu& nDofs  );    
 
+//// SimDomainDecomposition.cpp
+
+    //! Whether a colliding group is large enough to be split into subdomains
+    bool useDomainDecomposition( const CollidingGroup &cg ) const;
+
+    //! Splits the strands of a group into at most \p nDomains connected sets with similar numbers of contacts
+    /*! Each subdomain owns at least one contact ( mutual contacts belong to the subdomain of their first strand )
+        \return the actual number of subdomains */
+    unsigned partitionCollidingGroup( const CollidingGroup &cg, unsigned nDomains, std::vector<unsigned> &domains ) const;
+
+    //! Solves a colliding group by block Gauss-Seidel over subdomains, exchanging the impulses and velocities at their interfaces
+    /*! Outputs are laid out as by assembleBogusFrictionProblem() for the whole group */
+    bool solveByDomainDecomposition( CollidingGroup &cg, bool asFailSafe, bool nonLinear, std::vector<unsigned> &globalIds,
+            VecXx& vels, VecXx& impulses, VecXu& startDofs, VecXu& nDofs );
+
 //// SimTwistEdgeUtils.cpp
 
     void deleteInvertedProxies( const bool& penaltyAfter, const bool& penaltyOnce );
@@ -128,9 +237,12 @@ private:
 
     SimulationParameters& m_params; // there should only be one, this is a reference to Scene's simParams
     const std::vector< ElasticStrand* >& m_strands;
+    const std::vector< TriMesh* > m_meshes;
 
     std::vector< ImplicitStepper* > m_steppers;
 
+    std::vector< const TriMeshController* > m_levelSetControllers; //!< Meshes with a signed distance field
+
     std::vector< CollidingPairs > m_externalContacts;  //!< External contacts on each strand
     CollidingPairs m_mutualContacts;           //!< List of all rod-rod contacts
 
@@ -138,6 +250,25 @@ private:
     
     std::vector<unsigned> m_globalIds;
 
+    ImpulseCache m_previousImpulses; //!< Read-only during a step
+    ImpulseCache m_currentImpulses;  //!< Filled by postProcessBogusFrictionProblem()
+
+    //! Decayed count of the failsafes of each strand over the last steps
+    std::vector<Scalar> m_failsafeHistory;
+
+    // Cost model of the load balancing: decayed measured times of each strand, in seconds
+    std::vector<Scalar> m_strandDynamicsCost;
+    std::vector<Scalar> m_strandContactCost;
+    Scalar m_contactCostRate; //!< Seconds per unit of contactWork(), from the last steps
+
+    std::vector<char> m_activeStrands; //!< See setActiveStrands()
+
+    std::vector<unsigned> m_strandHomes; //!< Home thread of each strand in NUMA mode, empty otherwise
+
+    double m_phaseTimes[NUM_PHASES];
+
+    SimulationMetrics m_metrics;
+
     //! Index of colliding group in which each strand should be. Can be -1.
     std::vector<int> m_collidingGroupsIdx;
 
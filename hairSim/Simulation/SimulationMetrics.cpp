@@ -0,0 +1,102 @@
+#include "SimulationMetrics.h"
+
+#include <boost/thread/locks.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+SimulationMetrics::SimulationMetrics():
+    m_stepTime( 0. )
+{
+    // Counts by powers of two, residuals and times by decades
+    for( int h = 0; h < NUM_HISTOGRAMS; ++h )
+    {
+        m_histograms[h].m_lowest = 1.;
+        m_histograms[h].m_ratio = 2.;
+    }
+    m_histograms[GS_RESIDUAL].m_lowest = 1.e-12;
+    m_histograms[GS_RESIDUAL].m_ratio = 10.;
+    m_histograms[FRICTION_SOLVE_TIME].m_lowest = 1.e-6;
+    m_histograms[FRICTION_SOLVE_TIME].m_ratio = 10.;
+    clear();
+}
+
+void SimulationMetrics::clear()
+{
+    for( int c = 0; c < NUM_COUNTERS; ++c ){
+        m_counters[c] = 0;
+    }
+    for( int h = 0; h < NUM_HISTOGRAMS; ++h )
+    {
+        HistogramValues& values = m_histograms[h];
+        values.m_count = 0;
+        values.m_sum = 0.;
+        values.m_min = std::numeric_limits< Scalar >::infinity();
+        values.m_max = -std::numeric_limits< Scalar >::infinity();
+        std::fill( values.m_buckets, values.m_buckets + HistogramValues::NUM_BUCKETS, 0 );
+    }
+    m_stepTime = 0.;
+}
+
+void SimulationMetrics::sample( Histogram histogram, Scalar value )
+{
+    HistogramValues& values = m_histograms[histogram];
+    int bucket = 0;
+    if( value >= values.m_lowest ){
+        bucket = std::min( HistogramValues::NUM_BUCKETS - 1,
+                           1 + ( int ) std::floor( std::log( value / values.m_lowest ) / std::log( values.m_ratio ) ) );
+    }
+
+    boost::lock_guard< boost::mutex > lock( m_histogramsMutex );
+    ++values.m_count;
+    values.m_sum += value;
+    values.m_min = std::min( values.m_min, value );
+    values.m_max = std::max( values.m_max, value );
+    ++values.m_buckets[bucket];
+}
+
+const char* SimulationMetrics::name( Counter counter )
+{
+    static const char* names[NUM_COUNTERS] = { "proximityCandidates", "proximityContacts", "ctContacts",
+                                               "levelSetContacts", "reductionInputContacts", "reductionOutputContacts",
+                                               "frictionContacts", "warmStartedContacts", "notSPD",
+                                               "failsafeGroups", "failsafeStrands", "bandsCreated", "bandsDeleted" };
+    return names[counter];
+}
+
+const char* SimulationMetrics::name( Histogram histogram )
+{
+    static const char* names[NUM_HISTOGRAMS] = { "groupStrands", "groupContacts", "teamSize", "newtonIterations", "gsIterations",
+                                                   "warmGSIterations", "coldGSIterations", "gsResidual", "frictionSolveTime" };
+    return names[histogram];
+}
+
+void SimulationMetrics::write( std::ostream& os, int step, Scalar time ) const
+{
+    os << "{\"step\":" << step << ",\"time\":" << time << ",\"stepTime\":" << m_stepTime;
+    for( int c = 0; c < NUM_COUNTERS; ++c ){
+        os << ",\"" << name( ( Counter ) c ) << "\":" << m_counters[c];
+    }
+    for( int h = 0; h < NUM_HISTOGRAMS; ++h )
+    {
+        const HistogramValues& values = m_histograms[h];
+        os << ",\"" << name( ( Histogram ) h ) << "\":{\"count\":" << values.m_count;
+        if( values.m_count )
+        {
+            os << ",\"mean\":" << values.mean() << ",\"min\":" << values.m_min << ",\"max\":" << values.m_max;
+        }
+        // Lower bounds of the buckets past the first one, then the counts of all of them
+        os << ",\"buckets\":[";
+        Scalar bound = values.m_lowest;
+        for( int b = 1; b < HistogramValues::NUM_BUCKETS; ++b, bound *= values.m_ratio ){
+            os << ( b > 1 ? "," : "" ) << bound;
+        }
+        os << "],\"counts\":[";
+        for( int b = 0; b < HistogramValues::NUM_BUCKETS; ++b ){
+            os << ( b ? "," : "" ) << values.m_buckets[b];
+        }
+        os << "]}";
+    }
+    os << "}\n";
+}
@@ -0,0 +1,109 @@
+#ifndef SIMULATIONMETRICS_H_
+#define SIMULATIONMETRICS_H_
+
+#include "../Utils/Definitions.h"
+
+#include <boost/thread/mutex.hpp>
+
+#include <atomic>
+#include <ostream>
+
+/* [H]
+    Counters and histograms of what the last simulation step went through -- contacts,
+    colliding groups, solver iterations, failsafes -- to relate the time of a step to the
+    behaviour of the scene. Simulation::step() clears them first, and they can be updated
+    from any thread during the step.
+*/
+
+class SimulationMetrics
+{
+public:
+    enum Counter
+    {
+        PROXIMITY_CANDIDATES = 0, //!< Rod-rod edge pairs reaching the narrow phase of the proximity detection
+        PROXIMITY_CONTACTS, //!< Proximity contacts kept, mutual or external
+        CT_CONTACTS, //!< Contacts from continuous-time collisions, mutual or external
+        LEVEL_SET_CONTACTS, //!< Contacts with the signed distance fields of meshes
+        REDUCTION_INPUT_CONTACTS, //!< Mutual contacts before merging the nearly coincident ones
+        REDUCTION_OUTPUT_CONTACTS, //!< Mutual contacts left after merging
+        FRICTION_CONTACTS, //!< Contacts of the friction problems assembled during the step
+        WARM_STARTED_CONTACTS, //!< Those of them initialized with the impulse of a contact of the previous step
+        NOT_SPD, //!< Strands left with a non-SPD dynamics matrix, which refuse mutual contacts
+        FAILSAFE_GROUPS, //!< Colliding groups whose coupled solve failed or was rejected
+        FAILSAFE_STRANDS, //!< Strands of those groups solved again without their mutual contacts
+        BANDS_CREATED, //!< Twisted bands tracking missed collisions
+        BANDS_DELETED,
+        NUM_COUNTERS
+    };
+
+    enum Histogram
+    {
+        GROUP_STRANDS = 0, //!< Strands of each colliding group
+        GROUP_CONTACTS, //!< Mutual contacts of each colliding group
+        TEAM_SIZE, //!< Threads of each colliding group solved by its own team
+        NEWTON_ITERATIONS, //!< Newton iterations of the unconstrained dynamics of each strand
+        GS_ITERATIONS, //!< Iterations of each friction solve
+        WARM_GS_ITERATIONS, //!< Iterations of each friction solve started from previous impulses
+        COLD_GS_ITERATIONS, //!< Iterations of each friction solve started from zero impulses
+        GS_RESIDUAL, //!< Final residual of each friction solve
+        FRICTION_SOLVE_TIME, //!< Time of each friction solve, in seconds, with the solver chosen by the parameters
+        NUM_HISTOGRAMS
+    };
+
+    //! Samples of one histogram during the step
+    /*! Bucket 0 counts the values below m_lowest, bucket k > 0 those in
+        [ m_lowest * m_ratio^(k-1), m_lowest * m_ratio^k ), the last one also those above */
+    struct HistogramValues
+    {
+        static const int NUM_BUCKETS = 16;
+
+        unsigned m_count;
+        Scalar m_sum;
+        Scalar m_min;
+        Scalar m_max;
+        unsigned m_buckets[NUM_BUCKETS];
+
+        Scalar m_lowest;
+        Scalar m_ratio;
+
+        Scalar mean() const
+        { return m_count ? m_sum / m_count : 0.; }
+    };
+
+    SimulationMetrics();
+
+    void clear();
+
+    void add( Counter counter, long n = 1 )
+    { m_counters[counter] += n; }
+
+    void sample( Histogram histogram, Scalar value );
+
+    //! Wall time of the last step, set by the simulation once it is over
+    void setStepTime( double seconds )
+    { m_stepTime = seconds; }
+
+    long counter( Counter counter ) const
+    { return m_counters[counter]; }
+
+    //! Must not be called while the step updates the histograms
+    const HistogramValues& histogram( Histogram histogram ) const
+    { return m_histograms[histogram]; }
+
+    double stepTime() const
+    { return m_stepTime; }
+
+    static const char* name( Counter counter );
+    static const char* name( Histogram histogram );
+
+    //! Writes the metrics of the last step as a JSON object on one line
+    void write( std::ostream& os, int step, Scalar time ) const;
+
+private:
+    std::atomic< long > m_counters[NUM_COUNTERS];
+    HistogramValues m_histograms[NUM_HISTOGRAMS];
+    boost::mutex m_histogramsMutex;
+    double m_stepTime;
+};
+
+#endif /* SIMULATIONMETRICS_H_ */
@@ -6,6 +6,7 @@
 struct SimulationParameters
 {
     SimulationParameters():
+        m_numaMode( false ),
         m_useProxRodRodCollisions( true ),
         m_useCTRodRodCollisions( false ),
         m_alwaysUseNonLinear( true ),
@@ -13,11 +14,28 @@ struct SimulationParameters
         m_inextensibility_threshold( 1. ),
         m_stretching_threshold( 2.0 ),
         m_costretch_residual_threshold( 0.0 ),
-        m_stretchDamping( 0. )
+        m_stretchDamping( 0. ),
+        m_warmStartImpulses( true ),
+        m_warmStartAbscissaTolerance( 0.2 ),
+        m_coloredGSContactThreshold( 2000 ),
+        m_domainDecompositionMinStrands( 0 ),
+        m_domainDecompositionSubdomains( 0 ),
+        m_domainDecompositionMaxIters( 20 ),
+        m_useProjectedGradient( false ),
+        m_cadouxIterations( 10 ),
+        m_matrixFreeContactThreshold( 0 ),
+        m_failsafePredictionThreshold( 0. ),
+        m_contactReductionWindow( 0. ),
+        m_hLoop( false ),
+        m_trackGeometricRelations( true ),
+        m_penaltyAfter( true ),
+        m_penaltyOnce( true ),
+        m_cacheStaticMeshBVH( false )
     {}
 
     int m_numberOfThreads;
     bool m_simulationManager_limitedMemory;
+    bool m_numaMode; // pin the threads and give each strand a home thread, which allocates and steps its data
     unsigned m_maxNewtonIterations;
 
     /**
@@ -40,6 +58,31 @@ struct SimulationParameters
     double m_stretchDamping;
     double m_gaussSeidelTolerance;
 
+    /**
+     * Friction solve
+     */
+    bool m_warmStartImpulses; // whether GS starts from the impulses of matching contacts at the previous step
+    double m_warmStartAbscissaTolerance; // max. change of edge abscissa for two contacts to match across steps
+    unsigned m_coloredGSContactThreshold; // groups with at least this many contacts are solved by a colored, multithreaded GS (0 to disable)
+    unsigned m_domainDecompositionMinStrands; // groups with at least this many strands are split into subdomains solved in parallel (0 to disable)
+    unsigned m_domainDecompositionSubdomains; // number of subdomains, 0 for twice the number of threads
+    unsigned m_domainDecompositionMaxIters; // max. number of Gauss-Seidel sweeps over the subdomains
+    bool m_useProjectedGradient; // solve friction problems with an accelerated projected gradient (APGD) instead of GS
+    unsigned m_cadouxIterations; // number of Cadoux fixed-point iterations around each APGD solve
+    unsigned m_matrixFreeContactThreshold; // groups with at least this many contacts are solved without assembling the Delassus operator (0 to disable)
+    double m_failsafePredictionThreshold; // groups whose strands' decayed count of recent failsafes reaches this go straight to the failsafe (0 to disable)
+    double m_contactReductionWindow; // max. distance, in edges along both strands, between rod-rod contacts merged into one (0 to disable)
+
+    /**
+     * Tunneling
+     */
+    bool m_hLoop; // re-solve the collisions until no CT collision is left unresolved, for a few iterations
+    bool m_trackGeometricRelations; // detect the missed collisions at the end of the step and track them as twisted bands
+    bool m_penaltyAfter; // apply the penalty forces of the twisted bands after the step instead of during the dynamics
+    bool m_penaltyOnce; // delete the twisted bands once their penalty has been applied
+
+    bool m_cacheStaticMeshBVH; // store/reuse the BVH of static meshes next to their obj file
+
 };
 
 #endif 
@@ -35,6 +35,7 @@ ElasticStrand::ElasticStrand(
         m_globalIndex( globalIndex ),
         m_numVertices( m_parameters.getNumVertices() ),
         m_parameters( parameters ),
+        m_gravity( 0.0, -981.0, 0.0 ),
         m_currentState( new StrandState( dofs, m_parameters.getBendingMatrixBase() ) ),
         m_futureState( new StrandState( dofs, m_parameters.getBendingMatrixBase() ) ),
         m_dynamics( NULL ), 
@@ -305,6 +305,16 @@ public:
         return m_collisionParameters;
     }
 
+    const Vec3& getGravity() const
+    {
+        return m_gravity;
+    }
+
+    void setGravity( const Vec3& gravity )
+    {
+        m_gravity = gravity;
+    }
+
     Scalar getTotalRestLength() const
     {
         return m_totalRestLength;
@@ -546,6 +556,7 @@ private:
     // Other physical parameters
     ElasticStrandParameters m_parameters;
     CollisionParameters m_collisionParameters;
+    Vec3 m_gravity; // Acceleration vector, in cm/s^2 to match Maya's units. Also, the y-axis is vertical.
 
     // Current and future geometry. They need to be pointers to be easily swapped.
     StrandState* m_currentState;
@@ -59,6 +59,14 @@ void StrandState::freeCachedQuantities()
     m_bendingProducts.free();
 }
 
+void StrandState::reallocate()
+{
+    freeCachedQuantities();
+
+    VecXx totalForce( m_totalForce );
+    m_totalForce.swap( totalForce );
+}
+
 bool StrandState::hasSmallForces( const Scalar lTwoTol, const Scalar lInfTol ) const
 {
     return ( ( m_totalForce.norm() / m_numVertices <= lTwoTol )
@@ -195,6 +195,9 @@ public:
 
     void resizeSelf();
     void freeCachedQuantities();
+    //! Frees the cached quantities and copies the force vector, so that they are reallocated by the calling thread
+    /*! With first-touch page placement, the storage then lives on the NUMA node of this thread */
+    void reallocate();
     bool hasSmallForces( const Scalar lTwoTol, const Scalar lInfTol ) const;
     Vec3 closestPoint( const Vec3& x ) const;
 
@@ -0,0 +1,140 @@
+#include "LocalSocketTransport.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdint.h>
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // SIGPIPE is then left to its default handling
+#endif
+
+LocalSocketTransport* LocalSocketTransport::fork( int numProcesses )
+{
+    // sockets[a][b] is the end held by process a of the pair connecting a and b
+    std::vector< std::vector< int > > sockets( numProcesses, std::vector< int >( numProcesses, -1 ) );
+    for( int a = 0; a < numProcesses; ++a )
+    {
+        for( int b = a + 1; b < numProcesses; ++b )
+        {
+            int pair[2];
+            if( socketpair( AF_UNIX, SOCK_STREAM, 0, pair ) != 0 )
+            {
+                std::cerr << "LocalSocketTransport: socketpair failed: " << strerror( errno ) << std::endl;
+                return NULL;
+            }
+            sockets[a][b] = pair[0];
+            sockets[b][a] = pair[1];
+        }
+    }
+
+    int rank = 0;
+    std::vector< pid_t > children;
+    for( int r = 1; r < numProcesses; ++r )
+    {
+        const pid_t pid = ::fork();
+        if( pid == 0 )
+        {
+            rank = r;
+            children.clear();
+            break;
+        }
+        if( pid < 0 )
+        {
+            std::cerr << "LocalSocketTransport: fork failed: " << strerror( errno ) << std::endl;
+            return NULL;
+        }
+        children.push_back( pid );
+    }
+
+    // Only keep this process' ends
+    for( int a = 0; a < numProcesses; ++a )
+    {
+        if( a == rank ){
+            continue;
+        }
+        for( int b = 0; b < numProcesses; ++b )
+        {
+            if( sockets[a][b] >= 0 ){
+                close( sockets[a][b] );
+            }
+        }
+    }
+
+    return new LocalSocketTransport( rank, sockets[rank], children );
+}
+
+LocalSocketTransport::LocalSocketTransport( int rank, const std::vector< int >& sockets, const std::vector< pid_t >& children ):
+    m_rank( rank ),
+    m_sockets( sockets ),
+    m_children( children )
+{}
+
+LocalSocketTransport::~LocalSocketTransport()
+{
+    for( unsigned p = 0; p < m_sockets.size(); ++p )
+    {
+        if( m_sockets[p] >= 0 ){
+            close( m_sockets[p] );
+        }
+    }
+    // The other processes stop as soon as they fail to reach this one
+    for( unsigned c = 0; c < m_children.size(); ++c ){
+        waitpid( m_children[c], NULL, 0 );
+    }
+}
+
+static bool writeAll( int socket, const char* data, size_t size )
+{
+    while( size > 0 )
+    {
+        const ssize_t written = ::send( socket, data, size, MSG_NOSIGNAL );
+        if( written < 0 && errno == EINTR ){
+            continue;
+        }
+        if( written <= 0 ){
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+static bool readAll( int socket, char* data, size_t size )
+{
+    while( size > 0 )
+    {
+        const ssize_t read = ::recv( socket, data, size, 0 );
+        if( read < 0 && errno == EINTR ){
+            continue;
+        }
+        if( read <= 0 ){
+            return false;
+        }
+        data += read;
+        size -= read;
+    }
+    return true;
+}
+
+bool LocalSocketTransport::send( int dest, const std::vector< char >& message )
+{
+    const uint64_t size = message.size();
+    return writeAll( m_sockets[dest], reinterpret_cast< const char* >( &size ), sizeof( size ) )
+        && writeAll( m_sockets[dest], message.data(), message.size() );
+}
+
+bool LocalSocketTransport::receive( int src, std::vector< char >& message )
+{
+    uint64_t size = 0;
+    if( !readAll( m_sockets[src], reinterpret_cast< char* >( &size ), sizeof( size ) ) ){
+        return false;
+    }
+    message.resize( size );
+    return readAll( m_sockets[src], message.data(), size );
+}
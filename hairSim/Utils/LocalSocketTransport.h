@@ -0,0 +1,41 @@
+#ifndef LOCALSOCKETTRANSPORT_H_
+#define LOCALSOCKETTRANSPORT_H_
+
+#include "Transport.h"
+
+#include <sys/types.h>
+
+/* [H]
+    Transport between processes of the same machine, forked from one another
+    and connected two by two by Unix socket pairs.
+*/
+
+class LocalSocketTransport: public Transport
+{
+public:
+    //! Forks the calling process into \p numProcesses processes, rank 0 being the calling one
+    /*! fork() only duplicates the calling thread: other threads must be stopped first.
+        \return the transport of each process, NULL if the processes could not be started */
+    static LocalSocketTransport* fork( int numProcesses );
+
+    //! Closes the sockets; rank 0 then waits for the other processes to exit
+    virtual ~LocalSocketTransport();
+
+    virtual int rank() const
+    { return m_rank; }
+
+    virtual int size() const
+    { return m_sockets.size(); }
+
+    virtual bool send( int dest, const std::vector< char >& message );
+    virtual bool receive( int src, std::vector< char >& message );
+
+private:
+    LocalSocketTransport( int rank, const std::vector< int >& sockets, const std::vector< pid_t >& children );
+
+    int m_rank;
+    std::vector< int > m_sockets; //!< Socket connected to each process, -1 for this one
+    std::vector< pid_t > m_children; //!< Processes forked by rank 0
+};
+
+#endif /* LOCALSOCKETTRANSPORT_H_ */
@@ -0,0 +1,184 @@
+#include "Profiler.h"
+
+#ifdef HAIRSIM_PROFILE
+
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <vector>
+
+namespace
+{
+
+struct Node
+{
+    int m_parent;
+    std::string m_path; //!< Names of the scopes from the root, separated by '/'
+};
+
+//! Counters of one thread, only written by that thread
+struct ThreadCounters
+{
+    ThreadCounters():
+        m_current( -1 )
+    {}
+
+    int m_current;
+    std::vector< double > m_seconds;
+    std::vector< long > m_calls;
+    std::map< std::pair< int, const char* >, int > m_children; //!< Nodes already looked up by this thread
+};
+
+boost::mutex s_mutex; // guards all of the below
+std::vector< Node > s_nodes;
+std::map< std::pair< int, std::string >, int > s_children;
+std::vector< ThreadCounters* > s_threads; // never freed, the pool's threads may be restarted
+std::ofstream s_file;
+bool s_json = false;
+
+thread_local ThreadCounters* s_counters = NULL;
+
+ThreadCounters& counters()
+{
+    if( !s_counters )
+    {
+        s_counters = new ThreadCounters();
+        boost::lock_guard< boost::mutex > lock( s_mutex );
+        s_threads.push_back( s_counters );
+    }
+    return *s_counters;
+}
+
+}
+
+bool Profiler::open( const std::string& filename )
+{
+    boost::lock_guard< boost::mutex > lock( s_mutex );
+    s_file.open( filename.c_str() );
+    if( !s_file.is_open() )
+    {
+        std::cerr << "Profiler: could not open " << filename << std::endl;
+        return false;
+    }
+    s_json = filename.size() >= 5 && filename.compare( filename.size() - 5, 5, ".json" ) == 0;
+    if( !s_json ){
+        s_file << "step,time,scope,calls,seconds" << std::endl;
+    }
+    return true;
+}
+
+void Profiler::close()
+{
+    boost::lock_guard< boost::mutex > lock( s_mutex );
+    s_file.close();
+}
+
+int Profiler::currentScope()
+{
+    return counters().m_current;
+}
+
+void Profiler::setCurrentScope( int scope )
+{
+    counters().m_current = scope;
+}
+
+int Profiler::enter( const char* name )
+{
+    ThreadCounters& thread = counters();
+    const std::pair< int, const char* > key( thread.m_current, name );
+    std::map< std::pair< int, const char* >, int >::const_iterator child = thread.m_children.find( key );
+
+    int scope;
+    if( child != thread.m_children.end() ){
+        scope = child->second;
+    }
+    else
+    {
+        // Same names from different translation units may not share their address, hence the string key
+        boost::lock_guard< boost::mutex > lock( s_mutex );
+        const std::pair< int, std::string > globalKey( thread.m_current, name );
+        std::map< std::pair< int, std::string >, int >::const_iterator node = s_children.find( globalKey );
+        if( node != s_children.end() ){
+            scope = node->second;
+        }
+        else
+        {
+            scope = s_nodes.size();
+            Node created;
+            created.m_parent = thread.m_current;
+            created.m_path = thread.m_current < 0 ? std::string( name ) : s_nodes[ thread.m_current ].m_path + "/" + name;
+            s_nodes.push_back( created );
+            s_children[ globalKey ] = scope;
+        }
+        thread.m_children[ key ] = scope;
+    }
+
+    if( scope >= ( int ) thread.m_seconds.size() )
+    {
+        thread.m_seconds.resize( scope + 1, 0. );
+        thread.m_calls.resize( scope + 1, 0 );
+    }
+    thread.m_current = scope;
+    return scope;
+}
+
+void Profiler::leave( int scope, int parent, double seconds )
+{
+    ThreadCounters& thread = counters();
+    thread.m_seconds[ scope ] += seconds;
+    ++thread.m_calls[ scope ];
+    thread.m_current = parent;
+}
+
+void Profiler::endStep( int step, double time )
+{
+    boost::lock_guard< boost::mutex > lock( s_mutex );
+
+    std::vector< double > seconds( s_nodes.size(), 0. );
+    std::vector< long > calls( s_nodes.size(), 0 );
+    for( unsigned t = 0; t < s_threads.size(); ++t )
+    {
+        ThreadCounters& thread = *s_threads[t];
+        for( unsigned n = 0; n < thread.m_seconds.size(); ++n )
+        {
+            seconds[n] += thread.m_seconds[n];
+            calls[n] += thread.m_calls[n];
+        }
+        std::fill( thread.m_seconds.begin(), thread.m_seconds.end(), 0. );
+        std::fill( thread.m_calls.begin(), thread.m_calls.end(), 0 );
+    }
+
+    if( !s_file.is_open() ){
+        return;
+    }
+
+    if( s_json ){
+        s_file << "{\"step\":" << step << ",\"time\":" << time << ",\"scopes\":{";
+    }
+    bool first = true;
+    for( unsigned n = 0; n < s_nodes.size(); ++n )
+    {
+        if( calls[n] == 0 ){
+            continue;
+        }
+        if( s_json )
+        {
+            s_file << ( first ? "" : "," ) << "\"" << s_nodes[n].m_path << "\":{\"calls\":" << calls[n] << ",\"seconds\":" << seconds[n] << "}";
+        }
+        else{
+            s_file << step << "," << time << "," << s_nodes[n].m_path << "," << calls[n] << "," << seconds[n] << "\n";
+        }
+        first = false;
+    }
+    if( s_json ){
+        s_file << "}}\n";
+    }
+    s_file.flush();
+}
+
+#endif /* HAIRSIM_PROFILE */
@@ -0,0 +1,90 @@
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+/* [H]
+    Hierarchical profiler of the simulation step, only compiled in with -DHAIRSIM_PROFILE
+    ( cmake -DHAIRSIM_PROFILE=ON ); PROFILE_SCOPE() expands to nothing otherwise.
+    PROFILE_SCOPE( "name" ) times the rest of the enclosing block as a child of the innermost
+    scope open on the same thread, and tasks of the thread pool are children of the scope that
+    queued them. Each thread accumulates into its own counters, and only takes a lock the first
+    time it opens a scope under a given parent.
+    endStep() adds up the threads, so the times of scopes run in parallel are CPU times and
+    may exceed the time of their parent.
+*/
+
+#ifdef HAIRSIM_PROFILE
+
+#include <omp.h>
+#include <string>
+
+class Profiler
+{
+public:
+    //! Writes a record per step to \p filename, as JSON lines if it ends with ".json", as CSV otherwise
+    static bool open( const std::string& filename );
+    static void close();
+
+    //! Writes the scopes timed since the last call, and resets them
+    /*! Must not be called while scopes are open on other threads */
+    static void endStep( int step, double time );
+
+    //! Scope open on the calling thread, -1 outside of any scope
+    static int currentScope();
+    static void setCurrentScope( int scope );
+
+    //! Opens the child \p name of the current scope on the calling thread
+    static int enter( const char* name );
+    //! Closes \p scope, \p parent becoming the current scope again
+    static void leave( int scope, int parent, double seconds );
+};
+
+class ProfileScope
+{
+public:
+    explicit ProfileScope( const char* name ):
+        m_parent( Profiler::currentScope() ),
+        m_scope( Profiler::enter( name ) ),
+        m_start( omp_get_wtime() )
+    {}
+
+    ~ProfileScope()
+    {
+        Profiler::leave( m_scope, m_parent, omp_get_wtime() - m_start );
+    }
+
+private:
+    int m_parent;
+    int m_scope;
+    double m_start;
+};
+
+//! Runs a task of the thread pool under the scope that queued it
+class ProfileTaskScope
+{
+public:
+    explicit ProfileTaskScope( int scope ):
+        m_previous( Profiler::currentScope() )
+    {
+        Profiler::setCurrentScope( scope );
+    }
+
+    ~ProfileTaskScope()
+    {
+        Profiler::setCurrentScope( m_previous );
+    }
+
+private:
+    int m_previous;
+};
+
+#define PROFILE_CONCAT_( a, b ) a##b
+#define PROFILE_CONCAT( a, b ) PROFILE_CONCAT_( a, b )
+#define PROFILE_SCOPE( name ) ProfileScope PROFILE_CONCAT( profileScope, __LINE__ )( name )
+
+#else
+
+#define PROFILE_SCOPE( name )
+
+#endif /* HAIRSIM_PROFILE */
+
+#endif /* PROFILER_H_ */
@@ -0,0 +1,246 @@
+#include "ThreadPool.h"
+
+#include <boost/bind.hpp>
+#include <omp.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+static thread_local unsigned s_threadIndex = 0;
+
+ThreadPool& ThreadPool::instance()
+{
+    static ThreadPool pool( boost::thread::hardware_concurrency() );
+    return pool;
+}
+
+ThreadPool::ThreadPool( unsigned numThreads ):
+    m_pending( 0 ),
+    m_running( false ),
+    m_pinned( false ),
+    m_numNodes( 1 )
+{
+    start( numThreads );
+}
+
+ThreadPool::~ThreadPool()
+{
+    stop();
+}
+
+unsigned ThreadPool::threadIndex()
+{
+    return s_threadIndex;
+}
+
+void ThreadPool::resize( unsigned numThreads )
+{
+    if( numThreads == this->numThreads() ){
+        return;
+    }
+    stop();
+    start( numThreads );
+}
+
+void ThreadPool::start( unsigned numThreads )
+{
+    m_queues.resize( std::max( 1u, numThreads ) );
+    m_running = true;
+    for( unsigned i = 1; i < m_queues.size(); ++i ){
+        m_workers.push_back( new boost::thread( boost::bind( &ThreadPool::workerLoop, this, i ) ) );
+    }
+    if( m_pinned ){
+        pin();
+    }
+}
+
+void ThreadPool::stop()
+{
+    {
+        boost::lock_guard< boost::mutex > lock( m_sleepMutex );
+        m_running = false;
+    }
+    m_wakeUp.notify_all();
+    for( unsigned i = 0; i < m_workers.size(); ++i )
+    {
+        m_workers[i]->join();
+        delete m_workers[i];
+    }
+    m_workers.clear();
+    m_queues.clear();
+}
+
+void ThreadPool::push( const Task& task )
+{
+    push( task, threadIndex() );
+}
+
+void ThreadPool::push( const Task& task, unsigned thread )
+{
+    Queue& queue = m_queues[ thread ];
+    {
+        boost::lock_guard< boost::mutex > lock( queue.m_mutex );
+        queue.m_tasks.push_back( task );
+    }
+    ++m_pending;
+
+    // Taking the lock makes sure a worker is either waiting or will see the new task
+    {
+        boost::lock_guard< boost::mutex > lock( m_sleepMutex );
+    }
+    m_wakeUp.notify_one();
+}
+
+bool ThreadPool::pop( unsigned index, Task& task )
+{
+    {
+        Queue& own = m_queues[ index ];
+        boost::lock_guard< boost::mutex > lock( own.m_mutex );
+        if( !own.m_tasks.empty() )
+        {
+            task = own.m_tasks.back();
+            own.m_tasks.pop_back();
+            --m_pending;
+            return true;
+        }
+    }
+
+    const unsigned n = m_queues.size();
+    for( unsigned k = 1; k < n; ++k )
+    {
+        Queue& other = m_queues[ ( index + k ) % n ];
+        boost::lock_guard< boost::mutex > lock( other.m_mutex );
+        if( !other.m_tasks.empty() )
+        {
+            task = other.m_tasks.front();
+            other.m_tasks.pop_front();
+            --m_pending;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::runPendingTask()
+{
+    Task task;
+    if( !pop( threadIndex(), task ) ){
+        return false;
+    }
+
+    // Same as on the workers, the thread waiting for a group may otherwise spawn a whole OpenMP team
+    const int ompThreads = omp_get_max_threads();
+    omp_set_num_threads( 1 );
+    task();
+    omp_set_num_threads( ompThreads );
+    return true;
+}
+
+void ThreadPool::workerLoop( unsigned index )
+{
+    s_threadIndex = index;
+    // Every core is already busy with a task, OpenMP regions reached from tasks run sequentially
+    omp_set_num_threads( 1 );
+
+    Task task;
+    while( true )
+    {
+        if( pop( index, task ) )
+        {
+            task();
+            continue;
+        }
+
+        boost::unique_lock< boost::mutex > lock( m_sleepMutex );
+        while( m_running && m_pending == 0 ){
+            m_wakeUp.wait( lock );
+        }
+        if( !m_running ){
+            return;
+        }
+    }
+}
+
+// Parses a cpulist such as "0-15,32-47"
+static std::vector< int > parseCpuList( const std::string& list )
+{
+    std::vector< int > cpus;
+    std::stringstream ss( list );
+    std::string range;
+    while( std::getline( ss, range, ',' ) )
+    {
+        int first = 0, last = 0;
+        const std::string::size_type dash = range.find( '-' );
+        std::stringstream( range.substr( 0, dash ) ) >> first;
+        last = first;
+        if( dash != std::string::npos ){
+            std::stringstream( range.substr( dash + 1 ) ) >> last;
+        }
+        for( int cpu = first; cpu <= last; ++cpu ){
+            cpus.push_back( cpu );
+        }
+    }
+    return cpus;
+}
+
+unsigned ThreadPool::pinThreads()
+{
+    m_nodeCpus.clear();
+    for( unsigned node = 0; ; ++node )
+    {
+        std::stringstream path;
+        path << "/sys/devices/system/node/node" << node << "/cpulist";
+        std::ifstream file( path.str().c_str() );
+        if( !file ){
+            break;
+        }
+        std::string list;
+        std::getline( file, list );
+        const std::vector< int > cpus = parseCpuList( list );
+        if( !cpus.empty() ){
+            m_nodeCpus.push_back( cpus );
+        }
+    }
+    if( m_nodeCpus.empty() ){
+        m_nodeCpus.push_back( std::vector< int >() );
+    }
+
+    m_numNodes = std::min( ( unsigned ) m_nodeCpus.size(), numThreads() );
+    m_pinned = true;
+    pin();
+
+    return m_numNodes;
+}
+
+void ThreadPool::pin()
+{
+    m_numNodes = std::min( ( unsigned ) m_nodeCpus.size(), numThreads() );
+#ifdef __linux__
+    for( unsigned thread = 0; thread < numThreads(); ++thread )
+    {
+        const unsigned node = threadNode( thread );
+        const std::vector< int >& cpus = m_nodeCpus[node];
+        if( cpus.empty() ){
+            continue;
+        }
+        // Index of the thread among the threads of its node
+        unsigned rank = thread;
+        while( rank > 0 && threadNode( rank - 1 ) == node ){
+            --rank;
+        }
+        rank = thread - rank;
+
+        cpu_set_t set;
+        CPU_ZERO( &set );
+        CPU_SET( cpus[ rank % cpus.size() ], &set );
+        const pthread_t handle = thread == 0 ? pthread_self() : m_workers[ thread - 1 ]->native_handle();
+        pthread_setaffinity_np( handle, sizeof( set ), &set );
+    }
+#endif
+}
@@ -0,0 +1,210 @@
+#ifndef THREADPOOL_HH_
+#define THREADPOOL_HH_
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <vector>
+
+/* [H]
+    Persistent pool of worker threads shared by the whole simulation.
+    Each thread owns a deque of tasks: it pushes and pops at the back of its own,
+    and steals from the front of the others' when it runs out of work, so that
+    the first queued chunks of a loop are the first ones to be picked up.
+    A thread waiting for its tasks keeps running pending tasks meanwhile, so nested
+    parallel_for() calls neither add threads nor block a worker.
+    Threads outside of the pool, such as the one that calls resize() or the drivers of
+    concurrent scenes, all share the deque of thread 0.
+
+    On NUMA machines pinThreads() binds consecutive threads to the cores of the same node,
+    so that data first touched by a thread stays local to the threads it is stolen by first.
+*/
+
+class ThreadPool
+{
+public:
+    typedef std::function< void() > Task;
+
+    //! The pool used by the simulation, with one thread per core until resize() is called
+    static ThreadPool& instance();
+
+    //! Number of threads running tasks, the submitting thread included
+    unsigned numThreads() const
+    { return m_queues.size(); }
+
+    //! Restarts the pool with \p numThreads threads. Must not be called while tasks are pending
+    void resize( unsigned numThreads );
+
+    //! Index of the calling thread in [0, numThreads()), 0 for threads outside of the pool
+    static unsigned threadIndex();
+
+    //! Queues a task on the deque of the calling thread
+    void push( const Task& task );
+    //! Queues a task on the deque of thread \p thread, eg. the one owning its data
+    void push( const Task& task, unsigned thread );
+
+    //! Pins each thread to a core, threads being spread over the NUMA nodes by blocks of consecutive indices
+    /*! Reads the topology from /sys, and stays pinned across resize()
+        \return the number of NUMA nodes */
+    unsigned pinThreads();
+
+    //! Number of NUMA nodes the threads are spread over, 1 until pinThreads() is called
+    unsigned numNodes() const
+    { return m_numNodes; }
+
+    //! NUMA node of thread \p thread
+    unsigned threadNode( unsigned thread ) const
+    { return m_pinned ? thread * m_numNodes / numThreads() : 0; }
+
+    //! Runs one pending task, from the calling thread's deque first
+    /*! \return false if there was none */
+    bool runPendingTask();
+
+    ~ThreadPool();
+
+private:
+    explicit ThreadPool( unsigned numThreads );
+
+    void start( unsigned numThreads );
+    void stop();
+
+    void workerLoop( unsigned index );
+    bool pop( unsigned index, Task& task );
+    void pin();
+
+    struct Queue
+    {
+        Queue()
+        {}
+
+        Queue( const Queue& )
+        {}
+
+        boost::mutex m_mutex;
+        std::deque< Task > m_tasks;
+    };
+
+    std::vector< Queue > m_queues;
+    std::vector< boost::thread* > m_workers;
+
+    std::atomic< int > m_pending; //!< Tasks queued but not started yet
+    boost::mutex m_sleepMutex;
+    boost::condition_variable m_wakeUp;
+    bool m_running;
+
+    bool m_pinned;
+    unsigned m_numNodes;
+    std::vector< std::vector< int > > m_nodeCpus;
+};
+
+//! Set of tasks that can be waited for together
+class TaskGroup
+{
+public:
+    explicit TaskGroup( ThreadPool& pool = ThreadPool::instance() ):
+        m_pool( pool ),
+        m_pending( 0 )
+    {}
+
+    ~TaskGroup()
+    {
+        wait();
+    }
+
+    //! Queues \p func, or runs it right away if the pool has no worker
+    template< typename Func >
+    void run( const Func& func )
+    {
+        if( m_pool.numThreads() < 2 )
+        {
+            func();
+            return;
+        }
+
+        ++m_pending;
+        std::atomic< int >* pending = &m_pending;
+#ifdef HAIRSIM_PROFILE
+        const int scope = Profiler::currentScope();
+        m_pool.push( [func, pending, scope]() { ProfileTaskScope profileScope( scope ); func(); --( *pending ); } );
+#else
+        m_pool.push( [func, pending]() { func(); --( *pending ); } );
+#endif
+    }
+
+    //! Queues \p func on the deque of thread \p thread; other threads can still steal it
+    template< typename Func >
+    void runOn( unsigned thread, const Func& func )
+    {
+        if( m_pool.numThreads() < 2 )
+        {
+            func();
+            return;
+        }
+
+        ++m_pending;
+        std::atomic< int >* pending = &m_pending;
+#ifdef HAIRSIM_PROFILE
+        const int scope = Profiler::currentScope();
+        m_pool.push( [func, pending, scope]() { ProfileTaskScope profileScope( scope ); func(); --( *pending ); }, thread );
+#else
+        m_pool.push( [func, pending]() { func(); --( *pending ); }, thread );
+#endif
+    }
+
+    //! Runs pending tasks until all the tasks of this group are done
+    void wait()
+    {
+        while( m_pending > 0 )
+        {
+            if( !m_pool.runPendingTask() ){
+                boost::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    ThreadPool& m_pool;
+    std::atomic< int > m_pending;
+};
+
+//! Calls func( i ) for i in [begin, end), by chunks of \p grain iterations queued in order
+/*! The default grain gives about eight chunks per thread */
+template< typename Func >
+void parallel_for( int begin, int end, const Func& func, int grain = 0 )
+{
+    ThreadPool& pool = ThreadPool::instance();
+    const int n = end - begin;
+    if( grain <= 0 ){
+        grain = std::max( 1, n / ( 8 * ( int ) pool.numThreads() ) );
+    }
+
+    if( pool.numThreads() < 2 || n <= grain )
+    {
+        for( int i = begin; i < end; ++i ){
+            func( i );
+        }
+        return;
+    }
+
+    TaskGroup group( pool );
+    for( int chunk = begin; chunk < end; chunk += grain )
+    {
+        const int chunkEnd = std::min( end, chunk + grain );
+        group.run( [&func, chunk, chunkEnd]() {
+            for( int i = chunk; i < chunkEnd; ++i ){
+                func( i );
+            }
+        } );
+    }
+    group.wait();
+}
+
+#endif /* THREADPOOL_HH_ */
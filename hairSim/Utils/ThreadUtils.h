@@ -13,6 +13,8 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
 
+#include "ThreadPool.h"
+
 typedef boost::mutex MutexType ;
 typedef boost::lock_guard< MutexType > LockGuard ;
 typedef boost::unique_lock< MutexType > UniqueLock ;
@@ -129,34 +131,19 @@ void for_each( ContainerT& list, const CallableT& obj, ReturnT(CallableT::*func)
 template<typename ContainerT, typename ReturnT, typename CallableT, typename ArgT>
 void parfor( ContainerT& vec, CallableT& obj, ReturnT(CallableT::*func)( ArgT ) )
 {
-    const unsigned N = vec.size();
-#pragma omp parallel for
-    for ( unsigned i = 0; i < N; ++i )
-    {
-        ( obj.*func )( vec[i] );
-    }
+    parallel_for( 0, ( int ) vec.size(), [&]( int i ) { ( obj.*func )( vec[i] ); } );
 }
 
 template<typename ContainerT, typename ReturnT, typename CallableT, typename ArgT>
 void parfor( ContainerT& vec, const CallableT& obj, ReturnT(CallableT::*func)( ArgT ) const )
 {
-    const unsigned N = vec.size();
-#pragma omp parallel for
-    for ( unsigned i = 0; i < N; ++i )
-    {
-        ( obj.*func )( vec[i] );
-    }
+    parallel_for( 0, ( int ) vec.size(), [&]( int i ) { ( obj.*func )( vec[i] ); } );
 }
 
 template<typename ContainerT, typename CallableT>
 void parfor( ContainerT& vec, CallableT& obj )
 {
-    const unsigned N = vec.size();
-#pragma omp parallel for
-    for ( unsigned i = 0; i < N; ++i )
-    {
-        obj( vec[i] );
-    }
+    parallel_for( 0, ( int ) vec.size(), [&]( int i ) { obj( vec[i] ); } );
 }
 
 #endif /* THREADUTILS_HH_ */
@@ -0,0 +1,33 @@
+#ifndef TRANSPORT_H_
+#define TRANSPORT_H_
+
+#include <vector>
+
+/* [H]
+    Point-to-point messages between the processes of a distributed simulation.
+    Messages between two processes arrive in the order they were sent.
+    Implementations may block in send() until the destination receives, so
+    two processes must not both send to each other before receiving.
+*/
+
+class Transport
+{
+public:
+    virtual ~Transport()
+    {}
+
+    //! Index of this process, in [0, size())
+    virtual int rank() const = 0;
+
+    //! Number of processes
+    virtual int size() const = 0;
+
+    //! \return false if process \p dest is gone
+    virtual bool send( int dest, const std::vector< char >& message ) = 0;
+
+    //! Blocks until the next message of process \p src arrives
+    /*! \return false if process \p src is gone */
+    virtual bool receive( int src, std::vector< char >& message ) = 0;
+};
+
+#endif /* TRANSPORT_H_ */
@@ -4,24 +4,16 @@
 #include "Scenes/Scene.h"
 #include "Utils/Definitions.h"
 #include "Scenes/SceneUtils.h"
+#include "Scenes/FrameWriter.h"
 
 #include <tclap/CmdLine.h>
+#include <omp.h>
 #include <iomanip>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <sys/stat.h>
 
-// problems :
-#include "Scenes/Aleka.h"
-#include "Scenes/Braid.h"
-#include "Scenes/CousinIt.h"
-#include "Scenes/Knot.h"
-#include "Scenes/Locks.h"
-#include "Scenes/MultipleContact.h"
-#include "Scenes/Playback.h"
-#include "Scenes/SingleContact.h"
-//
 
 int g_problem_idx = -1;
 int g_window_width = 512;
@@ -46,44 +38,32 @@ Scalar g_fps = -1; // framerate to generate movies &/or dumps with
 int g_last_frame_num = -1; // last frame # that was output
 int g_current_frame = 0;
 
+// Headless runs
+int g_maxSteps = 0; // steps to run after the warm-up, 0 for no limit
+Scalar g_endTime = -1.; // simulated time to stop at, <= 0 for no limit
+int g_warmupSteps = 0; // steps left out of the timings, eg. building the BVHs and level sets
+
+// Exit codes, for scripts
+enum ExitCode
+{
+    EXIT_DONE = 0, // ran the requested steps, or until the scene was complete
+    EXIT_BAD_ARGUMENTS = 1,
+    EXIT_DIVERGED = 2 // NaNs in the strands
+};
+
 Scene* g_ps;
+FrameWriter* g_frameWriter = NULL; // writes the dumped frames in the background
 ViewController controller;
 
 using namespace std;
 
 void createProblem()
 {
-    switch( g_problem_idx )
+    g_ps = SceneUtils::createScene( g_problem_idx );
+    if( !g_ps )
     {
-        case 1:
-            g_ps = new CousinIt();
-            break;
-        case 2:
-            g_ps = new Playback();
-            g_ps->isSimulated( false );
-            break;
-        case 3:
-            g_ps = new SingleContact();
-            break;
-        case 4:
-            g_ps = new Aleka();
-            break;
-        case 5:
-            g_ps = new Knot(); // Not Tested, has tunneling
-            break;
-        case 6:
-            g_ps = new MultipleContact();
-            break;
-        case 7:
-            g_ps = new Braid();
-            break;
-        case 8:
-            g_ps = new Locks();
-            break;          
-        default:
-            cerr << "invalid Scene id" << endl;
-            std::exit( EXIT_FAILURE );
-            break;
+        cerr << "invalid Scene id" << endl;
+        std::exit( EXIT_FAILURE );
     }
 }
 
@@ -299,17 +279,15 @@ void output()
             
             if ( g_dumpcoord )
             {
-                g_ps->dumpRods( g_outputdirectory, g_current_frame, file_width );
-                if (! g_dont_dumpmesh ){
-                    SceneUtils::dumpMesh( g_outputdirectory, g_current_frame, file_width, g_ps->getMeshes() );
+                if( !g_frameWriter ){
+                    g_frameWriter = new FrameWriter();
                 }
-                
-                std::cout << "Saved coordinates of frame: " << g_current_frame << " @ time: " 
-                    << g_ps->getTime() << " in directory " << g_outputdirectory << std::endl;
+                g_frameWriter->push( *g_ps, g_ps->getMeshes(), g_outputdirectory, g_current_frame, file_width, !g_dont_dumpmesh );
             }
 
             if( g_dump_checkpoint )
             {
+                // Checkpoints are read back right away, so they are still written synchronously
                 g_ps->checkpointSave( g_outputdirectory );
                 g_ps->checkpointRestore( g_outputdirectory );
             }
@@ -321,7 +299,11 @@ void output()
 
 void stepOnce()
 {
-    g_ps->step();
+    if( !g_ps->step() )
+    {
+        std::cout << "# Scene complete. Exiting." << std::endl;
+        std::exit( EXIT_SUCCESS );
+    }
     if( g_render )
     { // If in render mode, update the display
         glutPostRedisplay();
@@ -501,6 +483,7 @@ void printStamp()
 void cleanup()
 {
     printStamp();
+    delete g_frameWriter; // flushes the pending frames
     delete g_ps;
 }
 
@@ -528,6 +511,11 @@ int parseCommandLine( int argc, char** argv )
         TCLAP::ValueArg<int> run( "r", "run", "Run a problem", true, -1, "int problem number", cmd );
         TCLAP::ValueArg<std::string> file( "f", "file", "Options file for a problem", true, "", "string option filename", cmd );
         TCLAP::ValueArg<bool> dumpcoord ( "d", "dumpcoord", "Dump coordinates of all rods and meshes at each frame", false, false, "boolean dumprods", cmd );
+        TCLAP::SwitchArg headless( "n", "headless", "Run without rendering, regardless of the options file", cmd, false );
+        TCLAP::ValueArg<int> steps( "s", "steps", "Run headless for N steps after the warm-up, then print timings and exit", false, 0, "int", cmd );
+        TCLAP::ValueArg<Scalar> endTime( "e", "endTime", "Run headless until this simulated time, then print timings and exit", false, -1., "float", cmd );
+        TCLAP::ValueArg<int> warmup( "w", "warmup", "Number of steps left out of the timings of a headless run", false, 0, "int", cmd );
+        TCLAP::ValueArg<int> threads( "t", "threads", "Number of threads, 0 for one per core; overrides the options file", false, 0, "int", cmd );
         cmd.parse(argc, argv);
         
         if( run.isSet() )
@@ -556,6 +544,18 @@ int parseCommandLine( int argc, char** argv )
             }
 
             getOptions();
+
+            if( threads.isSet() ){
+                g_ps->GetIntOpt( "numberOfThreads" ) = threads.getValue();
+            }
+            g_maxSteps = steps.getValue();
+            g_endTime = endTime.getValue();
+            g_warmupSteps = warmup.getValue();
+            if( headless.getValue() || g_maxSteps > 0 || g_endTime > 0. )
+            {
+                g_render = false;
+                g_paused = false;
+            }
             
             return g_problem_idx;
         }
@@ -589,6 +589,76 @@ void printCommandLineSplashScreen()
     std::cout << "# problem: " << g_ps->m_problemName << std::endl;
 }
 
+void printRunReport( int steps, double wallTime, Scalar simulatedTime )
+{
+    std::cout << "# Run: " << steps << " steps in " << wallTime << " s, "
+              << ( wallTime > 0. ? steps / wallTime : 0. ) << " steps/s, "
+              << ( wallTime > 0. ? simulatedTime / wallTime : 0. ) << " simulated s/s" << std::endl;
+
+    const Simulation* simulation = g_ps->getSimulation();
+    if( !simulation || steps == 0 || wallTime <= 0. ){
+        return;
+    }
+    std::cout << "# phase                   total (s)  per step (ms)   share" << std::endl;
+    double phasesTime = 0.;
+    for( int p = 0; p <= Simulation::NUM_PHASES; ++p )
+    {
+        // The last line is the time spent outside of Simulation::step(): scripts, halo exchange, output
+        const bool other = p == Simulation::NUM_PHASES;
+        const double time = other ? wallTime - phasesTime : simulation->phaseTime( ( Simulation::Phase ) p );
+        phasesTime += time;
+        std::cout << "# " << std::left << std::setw(20) << ( other ? "other" : Simulation::phaseName( ( Simulation::Phase ) p ) ) << std::right
+                  << std::setw(12) << time
+                  << std::setw(15) << 1.e3 * time / steps
+                  << std::setw(7) << floor( 1000. * time / wallTime + .5 ) / 10. << "%" << std::endl;
+    }
+}
+
+//! Runs the warm-up steps, then g_maxSteps steps or until g_endTime (or until the scene ends if neither is set), and prints the timings
+int runHeadless()
+{
+    int exitCode = EXIT_DONE;
+    bool complete = false;
+    for( int i = 0; i < g_warmupSteps && !complete; ++i )
+    {
+        complete = !g_ps->step();
+        output();
+
+        if( g_ps->hasNans() )
+        {
+            std::cerr << "# Run: NaNs in the strands after " << i + 1 << " warm-up steps" << std::endl;
+            return EXIT_DIVERGED;
+        }
+    }
+
+    const Scalar warmupTime = g_ps->getTime();
+    if( g_ps->getSimulation() ){
+        g_ps->getSimulation()->resetPhaseTimes();
+    }
+    const double start = omp_get_wtime();
+    int steps = 0;
+    while( !complete && ( g_maxSteps <= 0 || steps < g_maxSteps )
+            && ( g_endTime <= 0. || g_ps->getTime() < g_endTime - .5 * g_ps->getDt() ) )
+    {
+        if( !g_ps->step() ){
+            break;
+        }
+        ++steps;
+        output();
+
+        if( g_ps->hasNans() )
+        {
+            std::cerr << "# Run: NaNs in the strands after " << steps << " steps" << std::endl;
+            exitCode = EXIT_DIVERGED;
+            break;
+        }
+    }
+    const double wallTime = omp_get_wtime() - start;
+
+    printRunReport( steps, wallTime, g_ps->getTime() - warmupTime );
+    return exitCode;
+}
+
 std::string generateOutputDirName()
 { 
     time( &g_rawtime );
@@ -611,11 +681,23 @@ int main( int argc, char** argv )
     
     if( parseCommandLine( argc, argv ) < 0 )
     {
-        return -1;
+        return EXIT_BAD_ARGUMENTS;
     }
     
     g_ps->setup();
     if( g_restore_checkpoint ) g_ps->checkpointRestore();
+
+    // In a distributed simulation each process dumps its own strands, and only the first one renders
+    if( g_ps->GetIntOpt( "distributedProcesses" ) > 1 )
+    {
+        mkdir( g_outputdirectory.c_str(), 0755 );
+        std::stringstream rankDirectory;
+        rankDirectory << g_outputdirectory << "/rank" << g_ps->rank();
+        g_outputdirectory = rankDirectory.str();
+        if( g_ps->rank() > 0 ){
+            g_render = false;
+        }
+    }
     
     printCommandLineSplashScreen();
     
@@ -627,8 +709,7 @@ int main( int argc, char** argv )
         glutMainLoop();
     }
     else{
-        g_paused = false;
-        for(;;) idle();
+        return runHeadless();
     }
  
     return 0;
@@ -0,0 +1,214 @@
+
+#include "Scenes/Scene.h"
+#include "Scenes/SceneUtils.h"
+#include "Scenes/FrameWriter.h"
+#include "Utils/Definitions.h"
+#include "Utils/ThreadUtils.h"
+
+#include <tclap/CmdLine.h>
+#include <omp.h>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <sys/stat.h>
+
+/* [H]
+    Runs several independent scenes concurrently in one process, eg. for parameter sweeps.
+    Each scene is stepped by its own driver thread; the parallel loops of all the scenes
+    go through the same thread pool, so the cores left idle by one scene's serial parts
+    are used by the others.
+*/
+
+class SceneRun
+{
+public:
+    SceneRun( Scene* scene, const std::string& optionsFile, const std::string& outputdirectory,
+            int maxSteps, int dumpEvery, bool dumpMeshes, int ompThreads ):
+        m_scene( scene ),
+        m_optionsFile( optionsFile ),
+        m_outputdirectory( outputdirectory ),
+        m_maxSteps( maxSteps ),
+        m_dumpEvery( dumpEvery ),
+        m_dumpMeshes( dumpMeshes ),
+        m_ompThreads( ompThreads ),
+        m_steps( 0 ),
+        m_wallTime( 0. ),
+        m_writer( NULL )
+    {
+        if( m_dumpEvery > 0 ){
+            m_writer = new FrameWriter();
+        }
+    }
+
+    ~SceneRun()
+    {
+        delete m_writer; // flushes the pending frames
+        delete m_scene;
+    }
+
+    void start()
+    {
+        m_thread.run( this );
+    }
+
+    void join()
+    {
+        m_thread.join();
+    }
+
+    void operator()()
+    {
+        // The OpenMP regions of the scenes would otherwise each spawn a team as large as the machine
+        omp_set_num_threads( m_ompThreads );
+
+        const double start = omp_get_wtime();
+        while( m_maxSteps <= 0 || m_steps < m_maxSteps )
+        {
+            if( !m_scene->step() ){
+                break;
+            }
+            ++m_steps;
+
+            if( m_writer && m_steps % m_dumpEvery == 0 ){
+                m_writer->push( *m_scene, m_scene->getMeshes(), m_outputdirectory, m_steps / m_dumpEvery, 8, m_dumpMeshes );
+            }
+        }
+        m_wallTime = omp_get_wtime() - start;
+    }
+
+    void printReport( std::ostream& os, int index ) const
+    {
+        os << std::setw(4) << index << "  " << std::setw(16) << m_scene->m_problemName
+           << std::setw(8) << m_steps
+           << std::setw(12) << m_wallTime
+           << std::setw(12) << ( m_wallTime > 0. ? m_steps / m_wallTime : 0. )
+           << std::setw(12) << ( m_wallTime > 0. ? m_scene->getTime() / m_wallTime : 0. )
+           << "  " << m_optionsFile << std::endl;
+    }
+
+    int steps() const
+    { return m_steps; }
+
+private:
+    Scene* m_scene;
+    std::string m_optionsFile;
+    std::string m_outputdirectory;
+    int m_maxSteps; // 0 to run until the scene is complete
+    int m_dumpEvery;
+    bool m_dumpMeshes;
+    int m_ompThreads;
+
+    int m_steps;
+    double m_wallTime;
+
+    FrameWriter* m_writer;
+    ThreadHandle m_thread;
+};
+
+int main( int argc, char** argv )
+{
+    std::vector< int > problems;
+    std::vector< std::string > files;
+    int numThreads = 0;
+    int maxSteps = 0;
+    int dumpEvery = 0;
+    bool dumpMeshes = false;
+    std::string outputdirectory;
+
+    try
+    {
+        TCLAP::CmdLine cmd("hairSimBatch");
+        TCLAP::MultiArg<int> run( "r", "run", "Problem of a scene, once per scene", true, "int problem number", cmd );
+        TCLAP::MultiArg<std::string> file( "f", "file", "Options file of a scene, in the same order as --run", true, "string option filename", cmd );
+        TCLAP::ValueArg<int> threads( "t", "threads", "Number of threads shared by all the scenes, 0 for one per core", false, 0, "int", cmd );
+        TCLAP::ValueArg<int> steps( "s", "steps", "Max. number of steps of each scene, 0 to run each one until it completes", false, 0, "int", cmd );
+        TCLAP::ValueArg<int> dump( "d", "dumpEvery", "Dump the rods of each scene every N steps, 0 to disable", false, 0, "int", cmd );
+        TCLAP::SwitchArg meshes( "m", "meshes", "Also dump the meshes", cmd, false );
+        TCLAP::ValueArg<std::string> output( "o", "output", "Directory holding one output directory per scene", false, "batch_output", "string directory", cmd );
+        cmd.parse( argc, argv );
+
+        problems = run.getValue();
+        files = file.getValue();
+        numThreads = threads.getValue() > 0 ? threads.getValue() : boost::thread::hardware_concurrency();
+        maxSteps = steps.getValue();
+        dumpEvery = dump.getValue();
+        dumpMeshes = meshes.getValue();
+        outputdirectory = output.getValue();
+    }
+    catch (TCLAP::ArgException& e)
+    {
+        std::cerr << "ERROR: " << e.argId() << std::endl << "       " << e.error() << std::endl;
+        return -1;
+    }
+
+    if( problems.size() != files.size() )
+    {
+        std::cerr << "ERROR: each --run needs its --file" << std::endl;
+        return -1;
+    }
+
+    if( dumpEvery > 0 ){
+        mkdir( outputdirectory.c_str(), 0755 );
+    }
+
+    // Scenes are set up one after the other: setup() resizes the shared pool, which must not run tasks meanwhile
+    const int ompThreads = std::max( 1, numThreads / ( int ) problems.size() );
+    std::vector< SceneRun* > runs;
+    for( unsigned i = 0; i < problems.size(); ++i )
+    {
+        Scene* scene = SceneUtils::createScene( problems[i] );
+        if( !scene )
+        {
+            std::cerr << "invalid Scene id " << problems[i] << std::endl;
+            return -1;
+        }
+        if( scene->LoadOptions( files[i] ) == -1 ){
+            return -1;
+        }
+        scene->GetIntOpt( "numberOfThreads" ) = numThreads;
+        // Forking would duplicate the scenes already set up, and their drivers
+        scene->GetIntOpt( "distributedProcesses" ) = 1;
+        // The profiler is global to the process, the records of concurrent scenes would be mixed
+        scene->GetStringOpt( "profileFile" ) = "";
+        if( !scene->GetStringOpt( "metricsFile" ).empty() )
+        { // Scenes may share their options file, each one writes its metrics next to its output
+            mkdir( outputdirectory.c_str(), 0755 );
+            std::stringstream metrics;
+            metrics << outputdirectory << "/" << i << "_" << scene->m_problemName << "_metrics.json";
+            scene->GetStringOpt( "metricsFile" ) = metrics.str();
+        }
+        scene->setup();
+
+        std::stringstream name;
+        name << outputdirectory << "/" << i << "_" << scene->m_problemName;
+        runs.push_back( new SceneRun( scene, files[i], name.str(), maxSteps, dumpEvery, dumpMeshes, ompThreads ) );
+    }
+
+    std::cout << "# Batch: " << runs.size() << " scenes over " << numThreads << " threads" << std::endl;
+
+    const double start = omp_get_wtime();
+    for( unsigned i = 0; i < runs.size(); ++i ){
+        runs[i]->start();
+    }
+    int totalSteps = 0;
+    for( unsigned i = 0; i < runs.size(); ++i )
+    {
+        runs[i]->join();
+        totalSteps += runs[i]->steps();
+    }
+    const double wallTime = omp_get_wtime() - start;
+
+    std::cout << "# scene  problem            steps   wall (s)     steps/s  sim s/wall s  options" << std::endl;
+    for( unsigned i = 0; i < runs.size(); ++i ){
+        runs[i]->printReport( std::cout, i );
+    }
+    std::cout << "# Batch: " << totalSteps << " steps in " << wallTime << " s, "
+              << ( wallTime > 0. ? totalSteps / wallTime : 0. ) << " steps/s" << std::endl;
+
+    for( unsigned i = 0; i < runs.size(); ++i ){
+        delete runs[i];
+    }
+
+    return 0;
+}